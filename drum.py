@@ -40,13 +40,65 @@
 #   - Initializes everything
 #   - Input : maxNode
 #
-# void addLba(unsigned lba, unsigned num_of_blocks)
+# reorder_handle_t addLba(unsigned lba, unsigned num_of_blocks)
 #   - Receives an LBA and allocate an entry
 #   - Converts LBA into SG and track and set the LBA, SG, track fields in the entry
 #   - Insert the entry into TAVL tree
 #   - Insert the entry into SG group TAVL tree
 #   - Input : LBA, number of blocks
-#   - Output : None
+#   - Output : Handle of the entry
+#
+# void addLbaBatch(const unsigned *lbas, const unsigned *blocks, size_t n)
+#   - Same as calling addLba() for each LBA, but builds both trees at once out of the sorted LBAs
+#   - Input : LBAs, number of blocks of each (NULL for 1 block each), number of LBAs
+#   - Output : Number of LBAs added, less than given if the pool got full
+#
+# unsigned tryAddLba(unsigned lba, unsigned num_of_blocks, uint64_t tag, reorder_handle_t *pHandle)
+#   - Same as addLbaTagged() unless admission is closed above the high watermark set with setAdmission() or the pool is full
+#   - Output : REORDER_ADMITTED(0), REORDER_BUSY(1) or REORDER_FULL(2), handle of the entry when admitted
+#
+# const reorderStrategy_t *getReorderStrategy(unsigned strategy)
+# void setReorderStrategy(const reorderStrategy_t *pStrategy)
+#   - Switches the reordering scheme, LBA_SAWTOOTH_REORDERING(0) to WINDOW_DP(6), without losing pending entries
+#   - Input : Strategy from getReorderStrategy(), or one of the caller's own
+#
+# void setGovernor(const governorConfig_t *pConfig)
+#   - Switches between cheap and expensive strategies by queue depth, SG distance per I/O and CPU time per selection
+#   - Input : CPU budget per selection in ns and the strategies from the cheapest, NULL to turn off
+#
+# bool setTuning(unsigned param, unsigned value) / void setTuner(const tunerConfig_t *pConfig)
+#   - Sets maxTrackRange, maxBacktrack, the side trip and the shortest distance & LBA factors in eighths, or hill-climbs them online
+#   - Input : TUNE_... parameter and value / completions per measurement and minimum gain, 0 for the defaults, NULL to turn off
+#
+# bool setLookahead(unsigned depth, unsigned width)
+#   - Sets the hops (1 to 4) of the paths the lookahead strategy compares, and the nearest targets (1 to 8) it tries at each hop
+#   - Output : false if either is out of range
+#
+# bool setWindowDp(unsigned window, unsigned depth, unsigned hops)
+#   - Sets the next targets (2 to 12) window DP solves at once, the hops of the paths it compares (1 to window)
+#     and the hops of the shortest one it selects before solving again (1 to depth)
+#   - Window DP is experimental: it loses to shortest distance at low queue depth, see reorderLib.h
+#   - Output : false if any is out of range
+#
+# void setPlanner(bool on) / unsigned planReorder(unsigned maxEntries)
+#   - Plans path building ahead while an I/O is in flight, so that its selections only take the head of the planned list
+#   - Input : on or off / most entries to place. Output : entries placed
+#
+# bool startPlanner(const plannerConfig_t *pConfig) / void stopPlanner(void)
+#   - Plans path building ahead on a thread of its own, which the other calls lock the context against. Needs PLANNER_THREAD_POSIX.
+#   - Input : entries placed per hold of the lock, 0 for the default. Output : false if not built in or already running
+#
+# void getPlannedPath(unsigned *pEntries, unsigned *pDistance)
+#   - Gives the entries planned by path building and the SG distance of the path through them, kept as entries come and go
+#   - Output : entries, distance. A distance of NUMBER_OF_SG is one revolution
+#
+# unsigned improvePlan(uint64_t budgetNs)
+#   - Moves runs of 1 to 3 entries of the planned path where they take less distance, until a local optimum or out of time
+#   - Input : time in ns, e.g. what is left of an I/O in flight. Output : SG distance saved
+#
+# void setSelectBudget(const selectBudgetConfig_t *pConfig) / void getSelectBudgetStats(selectBudgetStats_t *pStats)
+#   - Bounds each selection by operations or time. When out, the best target found so far is taken, or the next in LBA if none
+#   - Input : operations and ns per selection, NULL to turn off / Output : selections cut short and whether the last one finished
 #
 # void getPhyFromLba(unsigned lba, unsigned *pSg, unsigned *pTrack)
 #   - Receives an LBA and returns SG and track
@@ -62,6 +114,12 @@
 #	- Updates the current to the given target
 #	- Note : The node is not given so the node needs to be searched using the target LBA.
 #
+# void selectTargetHandle(reorder_handle_t *pHandle, uint64_t *pTag, unsigned *pDistance)
+#   - Same as selectTargetLba() but returns the handle and the tag given with addLbaTagged()
+#
+# void completeHandle(reorder_handle_t handle)
+#   - Same as completeTarget() but without searching the tree, for the entry of the handle
+#
 
 import ctypes
 import platform
@@ -119,9 +177,9 @@ sg_and_track=np.empty((1,2),dtype=np.uint32)
 sg_and_track=np.delete(sg_and_track,0,0)
 # Why can't I use sg_and_track=np.array([[]])?
 
-# Added each entry into the cache (both TAVL tree and SG TAVL tree)
+# Add all entries into the cache at once (both TAVL tree and SG TAVL tree)
+reorderOperator.addLbaBatch(lbas)
 for lba in lbas:
-    reorderOperator.addLba(lba, 1)
     sg,track=reorderOperator.convertLbaToPhy(lba)
     sg_and_track=np.vstack([sg_and_track,[sg,track]])
 
@@ -4,6 +4,8 @@
 #define _REORDER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 
 //-----------------------------------------------------------
 // Macros
@@ -21,51 +23,192 @@
 #define NUMBER_OF_BLOCKS	(NUMBER_OF_SG*NUMBER_OF_TRACKS*BLOCKS_PER_SG)	// 180000000 blocks
 #define NUMBER_OF_REORDERED (5000)
 
-// Reordering schemes
+// Occupancy bitmap index over (SG x track band), used to skip SGs without any node in the searched track range.
+#define TRACKS_PER_BAND		(64)
+#define NUMBER_OF_BANDS		((NUMBER_OF_TRACKS+TRACKS_PER_BAND-1)/TRACKS_PER_BAND)
+#define BAND_WORDS			((NUMBER_OF_BANDS+63)/64)
+#define SG_WORDS			((NUMBER_OF_SG+63)/64)
+
+// Links of the reordered list reorderNewEntry() tries one revolution more in, and the longest section before each of them
+// it tries moving to the tail. See findSectionMove().
+#define SECTION_CANDIDATES	(48)
+#define SECTION_WINDOW		(32)
+// Longest run of entries of the reordered list improvePlanCtx() moves at once
+#define IMPROVE_MAX_RUN		(3)
+
+// Reordering schemes, each a strategy a context can run. See setReorderStrategyCtx().
 #define LBA_SAWTOOTH_REORDERING         (0) // Reorder only based on LBA, not considering angular or track
 #define SHORTEST_DIST                   (1) // Reorder by finding the local optimal, i.e. shortest distance from the current position
 #define SHORTEST_DIST_AND_LBA           (2) // Reorder by selecting between the local optimal & the one with higher LBA than the current
 #define SHORTEST_DIST_WITHIN_RANGE      (3) // Reorder by finding the local optimal within a range
 #define PATH_BUILDING_FROM_LBA          (4) // Reorder by building reordered list incrementally
-#define SELECTED_REORDERING             (SHORTEST_DIST_WITHIN_RANGE)
+#define LOOKAHEAD                       (5) // Reorder by the shortest path of a few hops ahead, taking only its first hop
+#define WINDOW_DP                       (6) // Reorder by the shortest path through the next few targets, solved exactly, taking its first hops.
+                                            // Experimental, see WINDOW_DP_DEFAULT_WINDOW
+#define NUMBER_OF_STRATEGIES            (7)
+#define SELECTED_REORDERING             (SHORTEST_DIST_WITHIN_RANGE)	// Strategy of a new context
+
+// Per SG containers
+#define SG_CONTAINER_TAVL               (0) // Threaded AVL tree per SG (pSgTavl), linked through segment_t.link[TAVL_LINK_SG]
+#define SG_CONTAINER_ARRAY              (1) // Sorted array of packed entries per SG (pSgArray), link[TAVL_LINK_SG] unused
+#define SELECTED_SG_CONTAINER           (SG_CONTAINER_TAVL)
+#define SG_ARRAY_MIN_CAPACITY           (8) // Initial number of entries of a SG array, doubled when full
+
+// Where the search of a SG container starts
+#define SG_SEARCH_FROM_ROOT             (0) // Descend from the root of the SG tree, or bisect the whole SG array
+#define SG_SEARCH_FROM_FINGER           (1) // Start from where the last search of the SG ended
+#define SELECTED_SG_SEARCH              (SG_SEARCH_FROM_FINGER)
+
+#define CACHE_LINE_SIZE					(64)
+
+// Segment pool layout. The first segments are not entries but the sentinels of the lists and the trees.
+#define NULL_SEG_IDX					(0)		// Index of no segment, never linked
+#define TAVL_LINK_LBA					(0)		// Links of the master tree, sorted in LBA
+#define TAVL_LINK_SG					(1)		// Links of the SG tree, used with SG_CONTAINER_TAVL only
+#define NUMBER_OF_TAVL_LINKS			(2)
+#define NUMBER_OF_SEG_LISTS				(5)		// Locked, LRU, Dirty, Free and dpReorder.reordered
+#if (SELECTED_SG_CONTAINER==SG_CONTAINER_ARRAY)
+#define NUMBER_OF_TAVLS					(1)		// cacheMgmt.tavl
+#else
+#define NUMBER_OF_TAVLS					(1+NUMBER_OF_SG)	// cacheMgmt.tavl and pSgTavl[]
+#endif
+#define FIRST_SEG_IDX					(1+2*NUMBER_OF_SEG_LISTS+2*NUMBER_OF_TAVLS)	// Index of the first entry segment
+
+// Segment pool growth. The address range for maxNode segments is reserved up front and backed with memory a slab at a time,
+// so that segment indices and the pool pointer never change.
+#define SEG_SLAB_SHIFT					(15)	// 32768 segments, 2 MiB of segments, 256 KiB of tags and 64 KiB of link distances per slab
+#define SEG_SLAB_SIZE					(1u<<SEG_SLAB_SHIFT)
+#define POOL_PAGES_NORMAL				(0)		// Base pages
+#define POOL_PAGES_THP					(1)		// Transparent huge pages requested with madvise(MADV_HUGEPAGE)
+#define POOL_PAGES_HUGETLB				(2)		// Segments in MAP_HUGETLB pages reserved up front, POOL_PAGES_THP if none are available
+#define SELECTED_POOL_PAGES				(POOL_PAGES_THP)
+
+// Submission ring in front of addLbaCtx() for multi-threaded producers
+#define SUBMIT_RING_SIZE				(4096)	// Number of entries, must be a power of 2
+
+// Admission control, see setAdmissionCtx()
+#define REORDER_ADMITTED				(0)		// tryAddLbaCtx() added the entry
+#define REORDER_BUSY					(1)		// tryAddLbaCtx() refused it as admission is closed above the high watermark
+#define REORDER_FULL					(2)		// tryAddLbaCtx() refused it as the segment pool is full
+#define REORDER_EVENT_HIGH_WATERMARK	(0)		// Pending entries reached the high watermark and admission closed
+#define REORDER_EVENT_LOW_WATERMARK		(1)		// Pending entries fell to the low watermark and admission opened again
+
+// Strategy governor, see setGovernorCtx()
+#define GOVERNOR_MAX_LEVELS				(NUMBER_OF_STRATEGIES)
+#define GOVERNOR_DEFAULT_WINDOW			(256)	// Selections per decision
+#define GOVERNOR_DEFAULT_PROBE			(64)	// Windows after which the measurements of another level are taken again
+#define GOVERNOR_DEFAULT_MARGIN			(5)		// Percent of SG distance per I/O that makes one level better than another
+#define GOVERNOR_DEPTH_CHANGE			(2)		// Measurements taken at a queue depth this many times off the current are stale
+#define GOVERNOR_FRACTION_BITS			(4)		// Fraction bits of governorStats_t.sgPerIo
+
+// Parameters of the strategies, in eighths, see setTuningCtx(). Each has its default, the lowest and the highest value.
+#define TUNE_TRACK_RANGE				(0)		// cacheMgmt.maxTrackRange, of the tracks the head seeks in half a revolution
+#define TUNE_BACKTRACK					(1)		// cacheMgmt.maxBacktrack, of cacheMgmt.maxTrackRange
+#define TUNE_SIDE_TRIP					(2)		// Extra distance a side trip out of the range may add, of the distance within range
+#define TUNE_AND_LBA					(3)		// Shortest distance wins over the next LBA while this much of it is still shorter
+#define NUMBER_OF_TUNABLES				(4)
+#define TUNE_TRACK_RANGE_DEFAULT		(8)
+#define TUNE_BACKTRACK_DEFAULT			(4)
+#define TUNE_SIDE_TRIP_DEFAULT			(2)
+#define TUNE_AND_LBA_DEFAULT			(12)
+
+// Lookahead, see setLookaheadCtx()
+#define LOOKAHEAD_MAX_DEPTH				(4)		// Hops of the paths compared
+#define LOOKAHEAD_MAX_WIDTH				(8)		// Nearest targets tried at each hop
+#define LOOKAHEAD_DEFAULT_DEPTH			(2)
+#define LOOKAHEAD_DEFAULT_WIDTH			(4)
+
+// Window DP, see setWindowDpCtx(). Experimental: no setting found beats SHORTEST_DIST at low queue depth, as new arrivals
+// keep changing the targets after the window. Against it, over 10000 selections, the defaults take 2-7x the CPU per selection
+// and lose 15% of the distance at 10 pending, 5% at 30 and 1.7% at 100, for a gain of 0.4% at 1000 and about 6% at 10^4.
+// A single hop per window (8/4/1) loses 3% at 10 and breaks even from 30 up, at 10-30x the CPU.
+#define WINDOW_DP_MAX_WINDOW			(12)	// Next targets solved at once
+#define WINDOW_DP_DEFAULT_WINDOW		(8)
+#define WINDOW_DP_DEFAULT_DEPTH			(8)
+#define WINDOW_DP_DEFAULT_HOPS			(8)
+
+// Selection budget, see setSelectBudgetCtx()
+#define SELECT_BUDGET_CLOCK_OPS			(32)	// Operations of a selection between reads of the clock against the deadline
+
+// Planner thread, see startPlannerCtx()
+#define PLANNER_THREAD_OFF				(0)		// Planning ahead only runs in planReorderCtx(), on the thread driving the context
+#define PLANNER_THREAD_POSIX			(1)		// startPlannerCtx() runs it on a thread of its own, locking the context. Link with -lpthread.
+#define SELECTED_PLANNER_THREAD			(PLANNER_THREAD_OFF)
+#define PLANNER_DEFAULT_BATCH			(4)		// Entries placed per hold of the context lock
+#define PLANNER_IDLE_NS					(100000)	// Sleep of the thread when it has nothing to place, as submitLbaCtx() does not wake it
+
+// Online tuner, see setTunerCtx()
+#define TUNER_DEFAULT_WINDOW			(2048)	// Completions per measurement
+#define TUNER_DEFAULT_GAIN				(5)		// Per mille less SG distance per I/O a trial value needs to be kept
+
+// Exact LBA lookup
+#define LBA_HASH_EMPTY					(0xffffffff)	// segIdx of an empty slot of the LBA hash
+#define LBA_HASH_LOAD_SHIFT				(1)				// Slots are at least the committed segments<<LBA_HASH_LOAD_SHIFT, keeping the load at 50% or below
+
+// Bulk load
+#define LBA_RADIX_BITS					(11)	// Bits per pass of the radix sort in addLbaBatchCtx(), 3 passes for 32 bit LBAs
+
+#if (SELECTED_PLANNER_THREAD==PLANNER_THREAD_POSIX)
+#include <pthread.h>
+#endif
 
 //-----------------------------------------------------------
 // Structure definitions
 //-----------------------------------------------------------
+// Index of a segment in pSegmentPool. Links are 32 bit indices instead of pointers,
+// so that a segment and its links in both trees fit in one cache line.
+typedef uint32_t segIdx_t;
+
+typedef struct tavl_link {
+    // Left and right index used for tree
+    segIdx_t	left;
+    segIdx_t	right;
+    // Lower and Higher index used for thread list (sorted in LBA)
+    segIdx_t	lower;
+    segIdx_t	higher;
+    // Parent in the tree, NULL_SEG_IDX for the root. Lets insertion and removal walk back up without recursion.
+    segIdx_t	parent;
+} tavl_link_t;
+
+// A pending entry and its links in the master tree and in its SG tree, in one cache line.
 typedef struct segment {
-    // Previous and Next pointer used for Locked/LRU/Dirty/Free list
-    struct segment  *prev;
-    struct segment  *next;
-    void            *pNode;
-    void            *pNodeSub;
-    unsigned        key;
-    unsigned        numberOfBlocks;
-    unsigned        sg;
-    unsigned        track;
+    // Previous and Next index used for Locked/LRU/Dirty/Free list
+    segIdx_t		prev;
+    segIdx_t		next;
+    unsigned		key;
+    unsigned		numberOfBlocks;
+    uint16_t		sg;
+    uint16_t		track;
+	uint8_t			height[NUMBER_OF_TAVL_LINKS];	// Height in each tree, indexed like link[]
 	bool			reordered;
-} segment_t;
-
-typedef struct tavl_node {
-    // Left and right pointer used for tree
-    struct tavl_node  *left;
-    struct tavl_node  *right;
-    // Lower and Higher pointer used for thread list (sorted in LBA)
-    struct tavl_node  *lower;
-    struct tavl_node  *higher;
-    segment_t       *pSeg;
-    unsigned        height;
-} tavl_node_t;
+	uint8_t			reserved;
+	tavl_link_t		link[NUMBER_OF_TAVL_LINKS];		// TAVL_LINK_LBA for cacheMgmt.tavl, TAVL_LINK_SG for pSgTavl[sg]
+} __attribute__((aligned(CACHE_LINE_SIZE))) segment_t;
+
+_Static_assert(sizeof(segment_t)==CACHE_LINE_SIZE, "segment_t must fill exactly one cache line");
 
+// Handle of a pending entry, the index of its segment in pSegmentPool.
+// Valid from addLbaCtx() until the entry is completed, after which the segment may be reused for another entry.
+typedef segIdx_t reorder_handle_t;
+
+// Handle returned when an entry could not be added as the segment pool is full
+#define REORDER_INVALID_HANDLE			((reorder_handle_t)NULL_SEG_IDX)
+
+// Head and tail are sentinel segments in the reserved part of pSegmentPool.
 typedef struct segList {
-    segment_t   head;
-    segment_t   tail;
+    segIdx_t	head;
+    segIdx_t	tail;
 } segList_t;
 
+// Nodes are segments of pPool, linked through link[linkSet]. Lowest and highest are sentinels in the reserved part of pPool.
 typedef struct tavl {
-    tavl_node_t *root;
-    tavl_node_t lowest;
-    tavl_node_t highest;
-    int         active_nodes;
+	segment_t	*pPool;
+	unsigned	linkSet;		// TAVL_LINK_LBA or TAVL_LINK_SG
+    segIdx_t	root;			// NULL_SEG_IDX if empty
+    segIdx_t	lowest;
+    segIdx_t	highest;
+    int			active_nodes;
+	segIdx_t	finger;			// Node the last finger search ended on, NULL_SEG_IDX if none. Moved to a neighbour when removed.
 } tavl_t;
 
 typedef struct cManagement {
@@ -74,12 +217,18 @@ typedef struct cManagement {
     segList_t   lru;
     segList_t   dirty;
     segList_t   free;
-	tavl_node_t	*pHigherNode;
+	segIdx_t	higherNode;		// Next node in the master thread after the last completed one, NULL_SEG_IDX before any completion
 	unsigned	currentSg;
 	unsigned	currentTrack;
 	unsigned	currentLba;
     unsigned    maxTrackRange;
     unsigned    maxBacktrack;
+	unsigned	tune[NUMBER_OF_TUNABLES];	// TUNE_... parameters of the strategies, in eighths
+	unsigned	maxNode;		// Number of segments pSegmentPool can grow to, after the reserved ones
+	unsigned	topNode;		// Number of segments ever allocated, after the reserved ones. Those above are untouched.
+	unsigned	committedSlabs;	// Number of SEG_SLAB_SIZE slabs backed with memory from the start of pSegmentPool, pTagPool and pLinkDist
+	bool		hugetlbPool;	// pSegmentPool is in MAP_HUGETLB pages
+	uint64_t	sgVisits;		// SG tree nodes or SG array entries looked at by the searches of the SG containers
 } cManagement_t;
 
 typedef struct dpReorder {
@@ -87,22 +236,293 @@ typedef struct dpReorder {
 	segment_t	*lbaRangeFirst;
 	segment_t	*lbaRangeLast;
 	unsigned	totalReordered;
-	unsigned	totalDist;
+	unsigned	totalDist;		// Sum of the distances of the links of the reordered list, see getPlannedPathCtx()
 	unsigned	lastLba;
+	// Link index of reorderNewEntry(). The link out of an entry of the reordered list is filed under the SG and track band
+	// of the entry, the same buckets as sgBitmap_t. A bound is only raised when a link is made, and lowered to the longest link
+	// of the band whenever reorderNewEntry() looks through the band, so it is never below the distance of a link out of the band.
+	uint16_t	linkBound[NUMBER_OF_SG][NUMBER_OF_BANDS];	// Upper bound of the distance of the links out of each track band of each SG
+	uint16_t	sgLinkBound[NUMBER_OF_SG];					// Upper bound of linkBound[] of each SG
+	uint64_t	distCalls;		// Distances taken by reorderNewEntry(), for the benchmarks
+	segIdx_t	improveFrom;	// Entry improvePlanCtx() carries on from, NULL_SEG_IDX to start from the second entry again
+	unsigned	improveTried;	// Entries tried by improvePlanCtx() since the last move, the whole list once it is at a local optimum
 } dpReorder_t;
 
-//-----------------------------------------------------------
-// Global variables
-//-----------------------------------------------------------
-extern	segment_t       *pSegmentPool;
-extern	tavl_node_t     *pNodePool;
-extern	tavl_t 			*pSgTavl;
-extern	cManagement_t   cacheMgmt;
-extern  dpReorder_t		dpReorder;
+typedef struct sgEntry {
+	unsigned	key;		// LBA
+	uint16_t	track;
+	uint16_t	reserved;
+	unsigned	segIdx;		// Index of the segment in pSegmentPool
+} sgEntry_t;
+
+typedef struct sgArray {
+	sgEntry_t	*pEntry;	// Sorted in LBA. As LBA increases with track, it is sorted in track too.
+	unsigned	count;
+	unsigned	capacity;
+	unsigned	finger;		// Index the last search ended on. Only a hint, as insertions and removals shift the entries.
+} sgArray_t;
+
+typedef struct lbaHashEntry {
+	unsigned	key;		// LBA
+	unsigned	segIdx;		// Index of the segment in pSegmentPool, LBA_HASH_EMPTY if the slot is empty
+} lbaHashEntry_t;
+
+// Open addressing hash table from LBA to segment, with linear probing.
+// Removal shifts the following entries back instead of leaving tombstones, so a lookup stops at the first empty slot.
+typedef struct lbaHash {
+	lbaHashEntry_t	*pEntry;
+	unsigned		mask;		// Number of slots - 1, the number of slots being a power of 2
+	unsigned		shift;		// 32 - log2(number of slots), to take the top bits of the multiplicative hash
+} lbaHash_t;
+
+typedef struct sgBitmap {
+	uint64_t	sgOccupied[SG_WORDS];						// One bit per SG, set when the SG has any node
+	uint64_t	bandOccupied[NUMBER_OF_SG][BAND_WORDS];		// One bit per track band of each SG, set when the band has any node
+	uint16_t	bandCount[NUMBER_OF_SG][NUMBER_OF_BANDS];	// Number of nodes in each track band of each SG
+} sgBitmap_t;
+
+typedef struct submitEntry {
+	uint64_t	sequence;		// Position this entry is ready for. pos: free for the producer of pos, pos+1: filled for the consumer
+	uint64_t	tag;
+	unsigned	lba;
+	unsigned	numberOfBlocks;
+} submitEntry_t;
+
+// Bounded multi-producer/single-consumer ring. Producers claim a position with CAS on tail and publish the entry with its sequence.
+// The consumer owns head and needs no atomic read-modify-write.
+// head and tail are kept on separate cache lines so that producers do not slow down the consumer and vice versa.
+typedef struct submitRing {
+	submitEntry_t	*pEntry;
+	uint64_t		mask;		// SUBMIT_RING_SIZE-1
+	uint8_t			pad0[CACHE_LINE_SIZE];
+	uint64_t		tail;		// Next position to be claimed by producers
+	uint64_t		rejected;	// Submissions refused as the ring was full, counted by the producers
+	uint8_t			pad1[CACHE_LINE_SIZE];
+	uint64_t		head;		// Next position to be drained by the consumer
+	uint8_t			pad2[CACHE_LINE_SIZE];
+} submitRing_t;
+
+struct reorderCtx;
+
+// Told of watermark crossings. Called from the add or completion that crossed it, on the thread using the context,
+// so it must not call back into the context; it is meant to signal the host's own queueing.
+typedef void (*reorder_watermark_cb_t)(struct reorderCtx *pCtx, unsigned event, unsigned pending, void *pArg);
+
+// Hooks of a reordering strategy. select is required, the others are NULL when the strategy has nothing to do.
+// The state a strategy keeps in the context is dpReorder, reset whenever the strategy of the context is changed.
+typedef struct reorderStrategy {
+	const char	*name;
+	// Pick the next target from the current position in cacheMgmt. There is at least one pending entry.
+	// When the selection budget runs out, give the best target found so far, or NULL if none. See setSelectBudgetCtx().
+	segment_t	*(*select)(struct reorderCtx *pCtx, unsigned *pDistance);
+	// The entry was just added into the trees.
+	void		(*onAdd)(struct reorderCtx *pCtx, segment_t *pSeg);
+	// The entry was completed and the current position moved to it. It is still in the trees.
+	void		(*onComplete)(struct reorderCtx *pCtx, segment_t *pSeg);
+	// The entry is about to leave the trees and go back to the free list.
+	void		(*onFree)(struct reorderCtx *pCtx, segment_t *pSeg);
+	// Entries must be completed in the order select() gives them, so admission control does not select in LBA instead.
+	bool		ownOrder;
+	// Bit of each TUNE_... parameter the strategy uses, for the tuner to try.
+	unsigned	tunables;
+	// Work ahead of the next selections, done off the critical path, see planReorderCtx(). Gives the units of work done.
+	unsigned	(*plan)(struct reorderCtx *pCtx, unsigned maxEntries);
+	// Improve the work done ahead within the given time, off the critical path, see improvePlanCtx(). Gives the distance saved.
+	unsigned	(*improve)(struct reorderCtx *pCtx, uint64_t budgetNs);
+} reorderStrategy_t;
+
+// Levels of the governor, from the cheapest strategy up to the most expensive.
+typedef struct governorConfig {
+	unsigned				cpuBudgetNs;		// CPU time per selection to stay within, 0 to turn the governor off
+	unsigned				window;				// Selections per decision, 0 for GOVERNOR_DEFAULT_WINDOW
+	unsigned				probeWindows;		// Windows before another level is measured again, 0 for GOVERNOR_DEFAULT_PROBE
+	unsigned				marginPercent;		// Difference in SG distance per I/O that is worth a level, 0 for GOVERNOR_DEFAULT_MARGIN
+	unsigned				numberOfLevels;		// 0 for sawtooth, shortest distance and shortest distance within range
+	const reorderStrategy_t	*pLevel[GOVERNOR_MAX_LEVELS];
+} governorConfig_t;
+
+typedef struct governorStats {
+	uint64_t	selections;		// Selections made while the governor was on
+	uint64_t	windows;		// Decisions made
+	uint64_t	stepsUp;		// Switches to a more expensive level
+	uint64_t	stepsDown;		// Switches to a cheaper level, including cpuLimited
+	uint64_t	cpuLimited;		// Switches down as the level went over the CPU budget
+	uint64_t	probes;			// Switches to a level with no or stale measurements
+	unsigned	level;			// Current level
+	unsigned	depth;			// Average pending entries over the last window
+	// Per level, the moving average of the windows it ran. I/Os per revolution is NUMBER_OF_SG/(sgPerIo>>GOVERNOR_FRACTION_BITS).
+	unsigned	sgPerIo[GOVERNOR_MAX_LEVELS];		// SG distance per selection, with GOVERNOR_FRACTION_BITS fraction bits, 0 if not measured
+	unsigned	nsPerSelection[GOVERNOR_MAX_LEVELS];
+	unsigned	measuredDepth[GOVERNOR_MAX_LEVELS];	// Average pending entries the level was last measured at
+} governorStats_t;
+
+typedef struct governor {
+	governorConfig_t	config;
+	governorStats_t		stats;
+	unsigned			age[GOVERNOR_MAX_LEVELS];	// Windows since the level was measured
+	uint64_t			windowNs;		// Sums over the current window
+	uint64_t			windowDist;
+	uint64_t			windowDepth;
+	unsigned			windowCount;
+} governor_t;
+
+typedef struct tunerConfig {
+	unsigned	window;				// Completions per measurement, 0 for TUNER_DEFAULT_WINDOW
+	unsigned	minGainPermille;	// Improvement a trial value needs to be kept, 0 for TUNER_DEFAULT_GAIN
+} tunerConfig_t;
+
+typedef struct tunerStats {
+	uint64_t	windows;		// Measurements taken
+	uint64_t	trials;			// Windows run with a parameter one step off the kept value
+	uint64_t	kept;			// Trials that were better by minGainPermille and became the kept value
+	uint64_t	reverted;		// Trials that were not, or whose strategy changed during the trial
+	unsigned	sgPerIo;		// SG distance per completion of the last baseline window, with GOVERNOR_FRACTION_BITS fraction bits
+	unsigned	value[NUMBER_OF_TUNABLES];	// Kept value of each parameter
+} tunerStats_t;
+
+typedef struct tuner {
+	tunerConfig_t	config;
+	tunerStats_t	stats;
+	bool			trial;		// The current window runs param one step off the kept value
+	unsigned		param;		// Parameter of the last or the current trial
+	int				step[NUMBER_OF_TUNABLES];	// Direction to try next for each parameter, +1 or -1
+	uint64_t		baseline;	// Total distance of the last baseline window
+	uint64_t		windowDist;
+	unsigned		windowCount;
+} tuner_t;
+
+typedef struct lookahead {
+	unsigned	depth;		// Hops of the paths compared, 1 to LOOKAHEAD_MAX_DEPTH. 1 is the same as SHORTEST_DIST.
+	unsigned	width;		// Nearest targets tried at each hop, 1 to LOOKAHEAD_MAX_WIDTH
+} lookahead_t;
+
+// Held-Karp dynamic programming of WINDOW_DP over subsets of the window, a bit per target of the window.
+typedef struct windowDp {
+	unsigned	window;		// Next targets solved at once, 2 to WINDOW_DP_MAX_WINDOW
+	unsigned	depth;		// Hops of the paths compared, 1 to window. Depth 1 is the same as SHORTEST_DIST.
+	unsigned	hops;		// Hops of a path selected before the next window is solved, 1 to depth
+	unsigned	next;		// Next hop of hop[] to select, moved on by a selection or by completing it unselected
+	unsigned	count;		// Hops of the path in hop[], dropped when any but the next is freed
+	segIdx_t	hop[WINDOW_DP_MAX_WINDOW];
+	// Scratch of a window
+	uint16_t	dist[WINDOW_DP_MAX_WINDOW][WINDOW_DP_MAX_WINDOW];	// Distance from each target of the window to each other
+	uint16_t	*pCost;		// 2^window x window, shortest path from the start through a subset, ending at a target of it. See setWindowDpCtx().
+} windowDp_t;
+
+typedef struct selectBudgetConfig {
+	unsigned	maxOps;		// Steps and SG container visits per selection, 0 for no limit. See selectBudget_t.steps.
+	unsigned	maxNs;		// Time per selection, 0 for no limit. Checked every SELECT_BUDGET_CLOCK_OPS operations.
+} selectBudgetConfig_t;
+
+typedef struct selectBudgetStats {
+	uint64_t	selections;		// Selections made with a budget
+	uint64_t	cutShort;		// Selections the budget ran out in, which took the best target found so far
+	uint64_t	fallbacks;		// Of cutShort, those that had found none and took the next entry in LBA
+	bool		finished;		// The last selection finished within the budget
+} selectBudgetStats_t;
+
+typedef struct selectBudget {
+	selectBudgetConfig_t	config;
+	selectBudgetStats_t		stats;
+	bool		armed;			// A selection with a budget is running
+	bool		exhausted;		// The budget of the running or the last selection ran out
+	unsigned	steps;			// SGs swept and entries placed on the reordered list by the running selection
+	uint64_t	opsLimit;		// cacheMgmt.sgVisits plus steps at which the running selection runs out
+	uint64_t	clockOps;		// cacheMgmt.sgVisits plus steps at which the clock is read next
+	uint64_t	deadlineNs;		// Time at which the running selection runs out, 0 for none
+} selectBudget_t;
+
+typedef struct plannerConfig {
+	unsigned	batch;		// Entries placed per hold of the context lock, 0 for PLANNER_DEFAULT_BATCH
+} plannerConfig_t;
+
+typedef struct plannerStats {
+	uint64_t	placed;		// Entries the thread placed
+	uint64_t	idle;		// Times it had nothing to place and slept
+} plannerStats_t;
+
+typedef struct planner {
+	plannerConfig_t	config;
+	plannerStats_t	stats;		// Written by the thread with the context locked
+	bool			running;	// Only changed by startPlannerCtx() and stopPlannerCtx(), on the thread driving the context
+#if (SELECTED_PLANNER_THREAD==PLANNER_THREAD_POSIX)
+	bool			stop;		// Set for the thread to return
+	unsigned		waiters;	// Entry points waiting for the lock, for the thread to let go of it between batches. Atomic.
+	pthread_mutex_t	lock;		// Recursive, as entry points call each other. Held by the entry points and by the thread while it plans.
+	pthread_cond_t	wake;		// Signalled by new entries and by stopPlannerCtx()
+	pthread_t		thread;
+#endif
+} planner_t;
+
+typedef struct admissionConfig {
+	unsigned				highWatermark;		// Pending entries at which admission closes, 0 to always admit
+	unsigned				lowWatermark;		// Pending entries at or below which admission opens again, below highWatermark
+	bool					sawtoothWhenClosed;	// Select the next entry in LBA while closed, the cheapest selection, to drain faster.
+												// Ignored with a strategy of reorderStrategy_t.ownOrder such as PATH_BUILDING_FROM_LBA.
+	reorder_watermark_cb_t	callback;			// NULL for none
+	void					*pArg;				// Given back to callback
+} admissionConfig_t;
+
+typedef struct admissionStats {
+	uint64_t	rejectedBusy;	// tryAddLbaCtx() refused as admission was closed
+	uint64_t	rejectedFull;	// tryAddLbaCtx() refused as the pool was full
+	uint64_t	rejectedRing;	// submitLbaCtx() refused as the ring was full
+	uint64_t	deferred;		// drainSubmissionsCtx() left a submission queued as admission was closed or the pool full
+	uint64_t	closed;			// Number of times admission closed at the high watermark
+} admissionStats_t;
+
+typedef struct admission {
+	admissionConfig_t	config;
+	admissionStats_t	stats;		// Except rejectedRing, counted in submitRing by the producers
+	bool				closed;		// From reaching the high watermark until falling to the low watermark
+} admission_t;
+
+/**
+ *  @brief  Scheduler context. Holds everything one drive needs, so that one process can schedule many drives.
+ *			Treat it as opaque and use createReorderCtx()/destroyReorderCtx() and the ...Ctx() functions.
+ *			The fields are visible only for the inline helpers below and the tests.
+ *			Contexts do not share any mutable state. Each one can be driven from its own thread without locking,
+ *			but a single context must not be used from more than one thread at a time.
+ *			The exceptions are submitLbaCtx(), which any number of threads can call along with the scheduler thread,
+ *			and the planner thread of startPlannerCtx(), which locks the context against the scheduler thread.
+ */
+typedef struct reorderCtx {
+	segment_t       *pSegmentPool;		// FIRST_SEG_IDX reserved segments, then up to cacheMgmt.maxNode entries
+	uint64_t		*pTagPool;			// Tag of each segment, indexed like pSegmentPool. Only read when a target is selected.
+	uint16_t		*pLinkDist;			// Distance of the link out of each segment of the reordered list to the next, indexed like pSegmentPool.
+										// Only valid while the segment is on the list and not its last entry.
+	tavl_t 			*pSgTavl;
+	sgArray_t		*pSgArray;
+	cManagement_t   cacheMgmt;
+	dpReorder_t		dpReorder;
+	sgBitmap_t		sgBitmap;
+	lbaHash_t		lbaHash;			// Exact LBA lookups. The master tree is only needed for ordered walks.
+	const reorderStrategy_t	*pStrategy;	// Reordering strategy, SELECTED_REORDERING unless set with setReorderStrategyCtx()
+	unsigned		*pInvSeekProfile;	// Number of tracks the head can seek and settle within the given number of SGs
+	unsigned		*pSeekProfile;		// Minimum number of SGs to seek and settle to a track the given number of tracks away
+	submitRing_t	submitRing;			// Submissions from other threads, drained before each selection
+	admission_t		admission;			// Watermarks closing tryAddLbaCtx() and the draining of submissions under overload
+	governor_t		governor;			// Switches pStrategy by queue depth, distance per I/O and CPU time per selection
+	tuner_t			tuner;				// Hill-climbs cacheMgmt.tune by the distance per completion
+	lookahead_t		lookahead;			// Depth and width of LOOKAHEAD
+	windowDp_t		windowDp;			// Window, depth, hops and the path being selected of WINDOW_DP
+	selectBudget_t	budget;				// Operations and time a selection can take
+	bool			planAhead;			// planReorderCtx() plans between selections, which then only take what was planned
+	planner_t		planner;			// Thread running planReorderCtx(), see startPlannerCtx()
+} reorder_ctx_t;
 
 //-----------------------------------------------------------
 // Functions
 //-----------------------------------------------------------
+/**
+ *  @brief  Get the links of the given segment in the given tree
+ *  @param  const tavl_t *pTavl - tree, segIdx_t idx - index of the segment, not NULL_SEG_IDX
+ *  @return pointer to the links
+ */
+static inline tavl_link_t *tavlLink(const tavl_t *pTavl, segIdx_t idx) {
+	return &pTavl->pPool[idx].link[pTavl->linkSet];
+}
+
 /**
  *  @brief  Initializes the given segment with a clean state
  *  @param  segment_t *pSeg - the segment to be initialized
@@ -111,126 +531,132 @@ extern  dpReorder_t		dpReorder;
 extern	void initSegment(segment_t *pSeg);
 
 /**
- *  @brief  Initializes the given node with a clean state
- *  @param  tavl_node_t *pNode - the node to be initialized
+ *  @brief  Initializes the links of the given segment in one tree with a clean state
+ *  @param  segment_t *pSeg - the segment, unsigned linkSet - TAVL_LINK_LBA or TAVL_LINK_SG
  *  @return None
  */
-extern	void initNode(tavl_node_t *pNode);
+extern	void initNode(segment_t *pSeg, unsigned linkSet);
 
 /**
  *  @brief  Inserts the given segment into the tail of the given list - Locked, LRU, Dirty or Free
- *  @param  segment_t *pSeg - the segment to be inserted, segList_t *pList - the destination list
+ *  @param  segment_t *pPool - segment pool, segment_t *pSeg - the segment to be inserted, segList_t *pList - the destination list
  *  @return None
  */
-extern	void pushToTail(segment_t *pSeg, segList_t *pList);
+extern	void pushToTail(segment_t *pPool, segment_t *pSeg, segList_t *pList);
 
 /**
  *  @brief  Removes the given segment from any list - Locked, LRU, Dirty or Free
  *          Note that the function does not need to know which list the segment is removed from
- *  @param  segment_t *pSeg - the segment to be removed
+ *  @param  segment_t *pPool - segment pool, segment_t *pSeg - the segment to be removed
  *  @return None
  */
-extern	void removeFromList(segment_t *pSeg);
+extern	void removeFromList(segment_t *pPool, segment_t *pSeg);
 
 /**
  *  @brief  Pops a segment from the head of the given list - Locked, LRU, Dirty or Free
- *  @param  segList_t *pList - the list
- *  @return The segment that got just popped
+ *  @param  segment_t *pPool - segment pool, segList_t *pList - the list
+ *  @return The segment that got just popped, or NULL if the list is empty
  */
-extern	segment_t *popFromHead(segList_t *pList);
+extern	segment_t *popFromHead(segment_t *pPool, segList_t *pList);
 
 /**
  *  @brief  Removes the given node from the LBA ordered thread.
- *  @param  tavl_node_t *pNode - the node to be removed
+ *  @param  tavl_t *pTavl - tree, segIdx_t node - the node to be removed
  *  @return None
  */
-extern	void removeFromThread(tavl_node_t *pNode);
+extern	void removeFromThread(tavl_t *pTavl, segIdx_t node);
 
 /**
  *  @brief  Inserts the given node before the target.
- *  @param  tavl_node_t *pNode - the node to be inserted, tavl_node_t *pTarget - target node
+ *  @param  tavl_t *pTavl - tree, segIdx_t node - the node to be inserted, segIdx_t target - target node
  *  @return None
  */
-extern	void insertBefore(tavl_node_t *pNode, tavl_node_t *pTarget);
+extern	void insertBefore(tavl_t *pTavl, segIdx_t node, segIdx_t target);
 
 /**
  *  @brief  Inserts the given node after the target.
- *  @param  tavl_node_t *pNode - the node to be inserted, tavl_node_t *pTarget - target node
+ *  @param  tavl_t *pTavl - tree, segIdx_t node - the node to be inserted, segIdx_t target - target node
  *  @return None
  */
-extern	void insertAfter(tavl_node_t *pNode, tavl_node_t *pTarget);
+extern	void insertAfter(tavl_t *pTavl, segIdx_t node, segIdx_t target);
 
 /**
  *  @brief  Inserts the given segment prior to the target.
- *  @param  segment_t *pSeg - the segment to be inserted, segment_t *pTarget - target segment
+ *  @param  segment_t *pPool - segment pool, segment_t *pSeg - the segment to be inserted, segment_t *pTarget - target segment
  *  @return None
  */
-extern	void insertPriorTo(segment_t *pSeg, segment_t *pTarget);
+extern	void insertPriorTo(segment_t *pPool, segment_t *pSeg, segment_t *pTarget);
 
 /**
  *  @brief  Inserts the given segment next to the target.
- *  @param  segment_t *pSeg - the segment to be inserted, segment_t *pTarget - target segment
+ *  @param  segment_t *pPool - segment pool, segment_t *pSeg - the segment to be inserted, segment_t *pTarget - target segment
  *  @return None
  */
-extern	void insertNextTo(segment_t *pSeg, segment_t *pTarget);
+extern	void insertNextTo(segment_t *pPool, segment_t *pSeg, segment_t *pTarget);
 
 /**
  *  @brief  Returns the heigh of the given node
- *  @param  tavl_node_t *head - a node in the AVL tree, or NULL
+ *  @param  const tavl_t *pTavl - tree, segIdx_t head - a node in the AVL tree, or NULL_SEG_IDX
  *  @return unsigned height of the node
  */
-extern	unsigned avlHeight(tavl_node_t *head);
+extern	unsigned avlHeight(const tavl_t *pTavl, segIdx_t head);
 
 /**
  *  @brief  Rotates the sub-tree to right (clockwise)
- *  @param  tavl_node_t *head - a node in the AVL tree - cannot be NULL
+ *			The new root of the sub-tree takes over the parent of head. The caller links it to that parent.
+ *  @param  tavl_t *pTavl - tree, segIdx_t head - a node in the AVL tree - cannot be NULL_SEG_IDX
  *  @return root of the rotated sub-tree
  */
-extern	tavl_node_t *rightRotation(tavl_node_t *head);
+extern	segIdx_t rightRotation(tavl_t *pTavl, segIdx_t head);
 
 /**
  *  @brief  Rotates the sub-tree to left (counter clockwise)
- *  @param  tavl_node_t *head - a node in the AVL tree - cannot be NULL
+ *			The new root of the sub-tree takes over the parent of head. The caller links it to that parent.
+ *  @param  tavl_t *pTavl - tree, segIdx_t head - a node in the AVL tree - cannot be NULL_SEG_IDX
  *  @return root of the rotated sub-tree
  */
-extern	tavl_node_t *leftRotation(tavl_node_t *head);
+extern	segIdx_t leftRotation(tavl_t *pTavl, segIdx_t head);
 
 /**
- *  @brief  Inserts the given node into the given AVL tree
- *  @param  tavl_node_t *head - a node in the AVL tree, or NULL
- *          tavl_node_t *x - a node to be inserted
- *  @return root of the new tree
+ *  @brief  Inserts the given node into the AVL tree of the given tree, iteratively, without touching the thread.
+ *			The key must not be in the tree yet.
+ *  @param  tavl_t *pTavl - tree, segIdx_t x - a node to be inserted
+ *  @return None
  */
-extern	tavl_node_t *insertNode(tavl_node_t *head, tavl_node_t *x);
+extern	void insertNode(tavl_t *pTavl, segIdx_t x);
 
 /**
- *  @brief  Removes the given segment from the given AVL tree
- *          Note that the entity being removed is segment, not a node.
- *          This is because remove operation may swap the content of the node
- *          to be removed with another node that has a key just higher.
- *  @param  tavl_node_t *head - a node in the AVL tree, or NULL
- *          segment_t *x - a segment to be removed
- *  @return root of the new tree
- *	@note	removeNodeSub() is for removing the segment from SG tree
+ *  @brief  Removes the given node from the given TAVL tree and its thread.
+ *			The node is unlinked and the tree is fixed up from there to the root, without searching.
+ *			The nodes stay with their segments, so no other segment moves to another node.
+ *  @param  tavl_t *pTavl - tree, segIdx_t x - a node to be removed
+ *  @return None
  */
-extern	tavl_node_t *removeNode(tavl_node_t *head, segment_t *x);
-extern	tavl_node_t *removeNodeSub(tavl_node_t *head, segment_t *x);
+extern	void removeNode(tavl_t *pTavl, segIdx_t x);
 
 /**
  *  @brief  Searches the given AVL tree for the given key
- *  @param  tavl_node_t *head - a node in the AVL tree, or NULL
- *          unsigned key - a key to be searched
- *  @return The node that contains the key, or NULL
+ *  @param  const tavl_t *pTavl - tree, unsigned key - a key to be searched
+ *  @return The node that contains the key, or NULL_SEG_IDX
  */
-extern	tavl_node_t *searchAvl(tavl_node_t *head, unsigned key);
+extern	segIdx_t searchAvl(const tavl_t *pTavl, unsigned key);
 
 /**
  *  @brief  Searches the given TAVL tree for the given LBA
- *  @param  tavl_node_t *head - a node in the AVL tree, or NULL
- *          unsigned lba - an LBA to be searched
- *  @return The node that contains a key that is equal or smaller than the given LBA, or NULL
+ *  @param  const tavl_t *pTavl - tree, unsigned lba - an LBA to be searched
+ *  @return The node that contains a key that is equal or smaller than the given LBA (pTavl->lowest if none),
+ *			or NULL_SEG_IDX if the tree is empty
+ */
+extern	segIdx_t searchTavl(const tavl_t *pTavl, unsigned lba);
+
+/**
+ *  @brief  searchTavl() starting from the given node instead of the root. It climbs only as far as the LBA needs,
+ *			so the closer the node is to the LBA, the fewer nodes it visits.
+ *  @param  const tavl_t *pTavl - tree, not empty, segIdx_t from - a node in the tree, or NULL_SEG_IDX to descend from the root,
+ *			unsigned lba - an LBA to be searched, uint64_t *pVisits - incremented by the number of nodes visited
+ *  @return The node that contains a key that is equal or smaller than the given LBA (pTavl->lowest if none)
  */
-extern	tavl_node_t *searchTavl(tavl_node_t *head, unsigned lba);
+extern	segIdx_t searchTavlFrom(const tavl_t *pTavl, segIdx_t from, unsigned lba, uint64_t *pVisits);
 
 /**
  *  @brief  Inserts the given node into the given TAVL tree.
@@ -238,42 +664,154 @@ extern	tavl_node_t *searchTavl(tavl_node_t *head, unsigned lba);
  *          1. inserts the given node into AVL tree
  *          2. inserts the given node into the Thread
  *  @param  tavl_t *pTavl - pointer to the tavl structure
- *          tavl_node_t *x - pointer to the node to be inserted
- *  @return New root of the tree
+ *          segIdx_t x - the node to be inserted
+ *  @return None
  */
-extern tavl_node_t *insertToTavl(tavl_t *pTavl, tavl_node_t *x);
+extern	void insertToTavl(tavl_t *pTavl, segIdx_t x);
+
+/**
+ *  @brief  Builds the given TAVL tree, both the thread and a perfectly balanced AVL tree, out of the given nodes in O(n).
+ *			Anything that was in the tree is dropped.
+ *  @param  tavl_t *pTavl - pointer to the tavl structure
+ *          segIdx_t *pNode - nodes sorted by key without overlap, unsigned count - number of nodes
+ *  @return None
+ */
+extern	void buildTavl(tavl_t *pTavl, segIdx_t *pNode, unsigned count);
+
+/**
+ *  @brief  Merges the nodes in the thread of the given TAVL tree with the given nodes, both sorted by key, for buildTavl().
+ *  @param  tavl_t *pTavl - pointer to the tavl structure
+ *          segIdx_t *pNew - nodes sorted by key, not in the tree, unsigned count - number of nodes
+ *			segIdx_t *pMerged - array for the merged nodes, big enough for pTavl->active_nodes+count nodes
+ *  @return Number of merged nodes
+ */
+extern	unsigned mergeThreadWith(tavl_t *pTavl, segIdx_t *pNew, unsigned count, segIdx_t *pMerged);
 
 // Remove a node from AVL tree, thread and list the push to free list.
 // Specified list can be Locked/LRU/Dirty.
 // Returns the new root.
 /**
  *  @brief  Remove a segment_t from cache management TAVL tree and list & from SG TAVL tree, then push to the free list.
- *  @param  segment_t *x - segment to be removed
+ *  @param  reorder_ctx_t *pCtx - context, segment_t *x - segment to be removed
+ *  @return None
+ */
+extern	void freeNode(reorder_ctx_t *pCtx, segment_t *x);
+
+/**
+ *  @brief  Inserts the given segment into the given SG array, keeping the entries sorted in LBA.
+ *  @param  reorder_ctx_t *pCtx - context owning the segment, sgArray_t *pArray - SG array, segment_t *pSeg - the segment to be inserted
+ *  @return None
+ */
+extern	void insertToSgArray(reorder_ctx_t *pCtx, sgArray_t *pArray, segment_t *pSeg);
+
+/**
+ *  @brief  Merges the given segments into the given SG array in one pass, keeping the entries sorted in LBA.
+ *  @param  reorder_ctx_t *pCtx - context owning the segments, sgArray_t *pArray - SG array,
+ *			segment_t **ppSeg - segments sorted in LBA, none of them in the array yet, unsigned count - number of segments
+ *  @return None
+ */
+extern	void mergeIntoSgArray(reorder_ctx_t *pCtx, sgArray_t *pArray, segment_t **ppSeg, unsigned count);
+
+/**
+ *  @brief  Removes the given segment from the given SG array.
+ *  @param  sgArray_t *pArray - SG array, segment_t *pSeg - the segment to be removed
  *  @return None
  */
-extern	void freeNode(segment_t *x);
+extern	void removeFromSgArray(sgArray_t *pArray, segment_t *pSeg);
+
+/**
+ *  @brief  Finds the first entry of the given SG array that has equal or higher LBA than the given key, galloping from the given index.
+ *  @param  sgArray_t *pArray - SG array, unsigned hint - index to start from, any value,
+ *			unsigned key - LBA, uint64_t *pVisits - incremented by the number of entries looked at
+ *  @return Index of the entry, or pArray->count if there is none
+ */
+extern	unsigned lowerBoundSgArrayFrom(sgArray_t *pArray, unsigned hint, unsigned key, uint64_t *pVisits);
+
+/**
+ *  @brief  Adds the given LBA of the given segment to the LBA hash. The LBA must not be in it yet.
+ *  @param  lbaHash_t *pHash - LBA hash, unsigned key - LBA, unsigned segIdx - index of the segment in pSegmentPool
+ *  @return None
+ */
+extern	void insertToLbaHash(lbaHash_t *pHash, unsigned key, unsigned segIdx);
+
+/**
+ *  @brief  Removes the given LBA from the LBA hash. The LBA must be in it.
+ *  @param  lbaHash_t *pHash - LBA hash, unsigned key - LBA
+ *  @return None
+ */
+extern	void removeFromLbaHash(lbaHash_t *pHash, unsigned key);
+
+/**
+ *  @brief  Looks the given LBA up in the LBA hash.
+ *  @param  const lbaHash_t *pHash - LBA hash, unsigned key - LBA
+ *  @return Index of the segment in pSegmentPool, or LBA_HASH_EMPTY if the LBA is not in it
+ */
+extern	unsigned searchLbaHash(const lbaHash_t *pHash, unsigned key);
+
+/**
+ *  @brief  Marks the track band of the given SG as occupied by one more node.
+ *  @param  sgBitmap_t *pBitmap - occupancy bitmap, unsigned sg - SG, unsigned track - track
+ *  @return None
+ */
+extern	void addToSgBitmap(sgBitmap_t *pBitmap, unsigned sg, unsigned track);
+
+/**
+ *  @brief  Releases one node from the track band of the given SG, clearing the bits when the band or the SG gets empty.
+ *  @param  sgBitmap_t *pBitmap - occupancy bitmap, unsigned sg - SG, unsigned track - track
+ *  @return None
+ */
+extern	void removeFromSgBitmap(sgBitmap_t *pBitmap, unsigned sg, unsigned track);
+
+/**
+ *  @brief  Finds the next SG that has any node, starting from (and including) the given SG. Wraps around.
+ *  @param  sgBitmap_t *pBitmap - occupancy bitmap, unsigned sg - SG to start from
+ *  @return Number of SGs from the given SG to the found SG, or NUMBER_OF_SG if there is no node at all
+ */
+extern	unsigned nextOccupiedSg(sgBitmap_t *pBitmap, unsigned sg);
+
+/**
+ *  @brief  Search the nearest target from the given position within the given tracks, jumping over the SGs with nothing in reach.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned startLba - starting LBA, unsigned startSg - starting SG, unsigned startTrack - starting track,
+ *			unsigned trackLimitBottom - lowest track allowed, unsigned trackLimitTop - highest track allowed,
+ *			unsigned *pDistance - pointer for the distance in SGs
+ *  @return the segment of the target, or NULL if none found
+ */
+extern	segment_t *selectTargetWithinTracks(reorder_ctx_t *pCtx, unsigned startLba, unsigned startSg, unsigned startTrack, unsigned trackLimitBottom, unsigned trackLimitTop, unsigned *pDistance);
+
+/**
+ *  @brief  selectTargetWithinTracks() over all tracks, the shortest distance target
+ */
+extern	segment_t *selectTarget(reorder_ctx_t *pCtx, unsigned startLba, unsigned startSg, unsigned startTrack, unsigned *pDistance);
+
+/**
+ *  @brief  Checks if any track band overlapping the given track range of the given SG has a node.
+ *			Note that a band is coarser than a track, so a true return does not guarantee a node within the range.
+ *  @param  sgBitmap_t *pBitmap - occupancy bitmap, unsigned sg - SG, unsigned trackBottom - lowest track, unsigned trackTop - highest track
+ *  @return true if any overlapping band is occupied
+ */
+extern	bool bandsOccupied(sgBitmap_t *pBitmap, unsigned sg, unsigned trackBottom, unsigned trackTop);
 
 /**
  *  @brief  Searches the given TAVL tree for the given LBA and dump the path
- *  @param  tavl_node_t *head - a node in the AVL tree, or NULL
+ *  @param  const tavl_t *pTavl - tree, segIdx_t head - a node in the AVL tree, or NULL_SEG_IDX
  *          unsigned lba - an LBA to be searched
- *  @return The node that contains a key that is equal or smaller than the given LBA, or NULL
+ *  @return The node that contains a key that is equal or smaller than the given LBA, or NULL_SEG_IDX
  */
-extern	tavl_node_t *dumpPathToKey(tavl_node_t *head, unsigned lba);
+extern	segIdx_t dumpPathToKey(const tavl_t *pTavl, segIdx_t head, unsigned lba);
 
 /**
  *  @brief  Dumps all nodes in one SG.
- *  @param  unsigned sg - SG
+ *  @param  reorder_ctx_t *pCtx - context, unsigned sg - SG
  *  @return None
  */
-extern void dumpOneSgNodes(unsigned sg);
+extern void dumpOneSgNodes(reorder_ctx_t *pCtx, unsigned sg);
 
 /**
  *  @brief  Dumps all nodes in all SG.
- *  @param  None
+ *  @param  reorder_ctx_t *pCtx - context
  *  @return None
  */
-extern void dumpSgNodes(void);
+extern void dumpSgNodes(reorder_ctx_t *pCtx);
 
 //-----------------------------------------------------------
 // Public Functions, used by python lib
@@ -308,58 +846,468 @@ extern	void getNumOfTracks(unsigned *pNumberOfTracks);
  */
 extern	void getPhyFromLba(unsigned lba, unsigned *pSg, unsigned *pTrack);
 
+/**
+ *  @brief  Converts the given SG and track to the first LBA located there
+ *  @param  unsigned sg - SG, unsigned track - track
+ *  @return LBA
+ */
+extern	unsigned getLbaFromPhy(unsigned sg, unsigned track);
+
+/**
+ *  @brief  Allocates a context and initializes it with the given number of nodes.
+ *  @param  int maxNode - most nodes pending at the same time
+ *  @return the new context
+ */
+extern	reorder_ctx_t *createReorderCtx(int maxNode);
+
+/**
+ *  @brief  Frees the given context and everything allocated for it.
+ *  @param  reorder_ctx_t *pCtx - context created by createReorderCtx()
+ *  @return None
+ */
+extern	void destroyReorderCtx(reorder_ctx_t *pCtx);
+
+/**
+ *  @brief  Initializes the whole cache management structure of the given context - cacheMgmt, dpReorder, SG trees and seek profiles.
+ *			Anything allocated by the previous initialization of the context is freed first.
+ *			Only the address range of the segment pool is reserved for maxNode; memory is committed one slab at a time
+ *			as nodes are added, so the time taken does not depend on maxNode.
+ *  @param  reorder_ctx_t *pCtx - context, int maxNode - most nodes pending at the same time
+ *  @return None
+ */
+extern	void initCacheCtx(reorder_ctx_t *pCtx, int maxNode);
+
+/**
+ *  @brief  Returns the memory of the slabs above the highest pending node to the system.
+ *			The free nodes in those slabs are dropped from the free list, and are committed again when the pool grows back.
+ *			The LBA hash keeps its size.
+ *  @param  reorder_ctx_t *pCtx - context
+ *  @return Number of slabs released
+ */
+extern	unsigned shrinkPoolCtx(reorder_ctx_t *pCtx);
+
+/**
+ *  @brief  Get one of the strategies built in the library
+ *  @param  unsigned strategy - LBA_SAWTOOTH_REORDERING to WINDOW_DP
+ *  @return the strategy, NULL if there is none with the number
+ */
+extern	const reorderStrategy_t *getReorderStrategy(unsigned strategy);
+
+/**
+ *  @brief  Switches the given context to the given strategy, which may be one of the library or the caller's own.
+ *			Pending entries and queued submissions are kept; only the state the previous strategy built in dpReorder,
+ *			such as the reordered list of PATH_BUILDING_FROM_LBA, is reset. Can be called at any time between selections.
+ *  @param  reorder_ctx_t *pCtx - context, const reorderStrategy_t *pStrategy - strategy, kept until the next switch
+ *  @return None
+ */
+extern	void setReorderStrategyCtx(reorder_ctx_t *pCtx, const reorderStrategy_t *pStrategy);
+
+/**
+ *  @brief  Turns on the strategy governor of the given context, or off with NULL or a zero CPU budget.
+ *			Every window of selections, the governor measures the SG distance per I/O, the CPU time per selection and
+ *			the queue depth of the current level, then moves down a level when over the CPU budget, up when the next level
+ *			is better by the margin and fits the budget at the current depth, or down when the cheaper level is as good.
+ *			Levels with no measurements, or with stale ones for the probe period or a queue depth that changed, are tried.
+ *			It starts on the level of the current strategy, or the most expensive level if that is not one of them.
+ *  @param  reorder_ctx_t *pCtx - context, const governorConfig_t *pConfig - budget and levels
+ *  @return None
+ */
+extern	void setGovernorCtx(reorder_ctx_t *pCtx, const governorConfig_t *pConfig);
+
+/**
+ *  @brief  Sets a parameter of the strategies of the given context, and maxTrackRange and maxBacktrack from it
+ *  @param  reorder_ctx_t *pCtx - context, unsigned param - TUNE_..., unsigned value - eighths
+ *  @return false if the value is out of the range of the parameter and nothing was changed
+ */
+extern	bool setTuningCtx(reorder_ctx_t *pCtx, unsigned param, unsigned value);
+
+/**
+ *  @brief  Sets the paths LOOKAHEAD compares in the given context. From each hop, the width nearest targets are tried
+ *			for the next hop, down to depth hops, and the first hop of the shortest path is selected.
+ *			A selection sweeps the SGs at most 1+width+...+width^(depth-1) times, and fewer as costly paths are cut short.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned depth - 1 to LOOKAHEAD_MAX_DEPTH, unsigned width - 1 to LOOKAHEAD_MAX_WIDTH
+ *  @return false if either is out of range and nothing was changed
+ */
+extern	bool setLookaheadCtx(reorder_ctx_t *pCtx, unsigned depth, unsigned width);
+
+/**
+ *  @brief  Sets the window WINDOW_DP solves in the given context. Of the next window targets SHORTEST_DIST would take, the path
+ *			of depth hops that takes the shortest distance is found, and its first hops are selected before the next window,
+ *			which is solved from the last of them as it is selected.
+ *			The path is exact, found over the subsets of the window of up to depth targets, each in window^2 steps,
+ *			with a table of 2^window x window allocated here. The hops left of a path are dropped as soon as one of them
+ *			is freed out of turn, and selections carry on from the current position.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned window - 2 to WINDOW_DP_MAX_WINDOW, unsigned depth - 1 to window,
+ *			unsigned hops - 1 to depth
+ *  @return false if any is out of range and nothing was changed
+ */
+extern	bool setWindowDpCtx(reorder_ctx_t *pCtx, unsigned window, unsigned depth, unsigned hops);
+
+/**
+ *  @brief  Turns planning ahead on or off for the given context. When on, selections of PATH_BUILDING_FROM_LBA take the head
+ *			of the reordered list planReorderCtx() filled, and only put an entry on it themselves when it is empty.
+ *  @param  reorder_ctx_t *pCtx - context, bool on - plan ahead
+ *  @return None
+ */
+extern	void setPlannerCtx(reorder_ctx_t *pCtx, bool on);
+
+/**
+ *  @brief  Does the work of the current strategy ahead of the next selections, such as placing new entries on the reordered list
+ *			of PATH_BUILDING_FROM_LBA. Meant for while the head seeks and transfers, on the thread driving the context,
+ *			e.g. after the completion and the new entries of an I/O and before the next selection.
+ *			Like every other function of the context, it must not run along with them on another thread,
+ *			but for the planner thread of startPlannerCtx() that runs it.
+ *			Queued submissions are taken in first, so that they are planned too.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned maxEntries - most entries to place
+ *  @return number of entries placed, 0 if the strategy plans nothing ahead
+ */
+extern	unsigned planReorderCtx(reorder_ctx_t *pCtx, unsigned maxEntries);
+
+/**
+ *  @brief  Starts a thread planning ahead for the given context, and turns planning ahead on. The thread runs planReorderCtx()
+ *			for config.batch entries at a time with the context locked, and sleeps when there is nothing to place.
+ *			Between batches it lets go of the lock to whoever waits for it, so a selection waits for one batch at most.
+ *			While it runs, the scheduler thread can add, submit, select and complete entries, and plan and get the planned path;
+ *			the other functions of the context, such as its configuration, wait for stopPlannerCtx().
+ *			Needs SELECTED_PLANNER_THREAD of PLANNER_THREAD_POSIX.
+ *  @param  reorder_ctx_t *pCtx - context, const plannerConfig_t *pConfig - configuration, NULL or zeros for the defaults
+ *  @return false if the library was built without the planner thread, the thread already runs or could not be created
+ */
+extern	bool startPlannerCtx(reorder_ctx_t *pCtx, const plannerConfig_t *pConfig);
+
+/**
+ *  @brief  Stops the planner thread of the given context and waits for it, if it runs. Planning ahead stays on.
+ *  @param  reorder_ctx_t *pCtx - context
+ *  @return None
+ */
+extern	void stopPlannerCtx(reorder_ctx_t *pCtx);
+
+/**
+ *  @brief  Gets the counters of the planner thread of the given context, kept from its last start.
+ *  @param  reorder_ctx_t *pCtx - context, plannerStats_t *pStats - pointer for the counters
+ *  @return None
+ */
+extern	void getPlannerStatsCtx(reorder_ctx_t *pCtx, plannerStats_t *pStats);
+
+/**
+ *  @brief  Gets the path planned on the reordered list of PATH_BUILDING_FROM_LBA, kept up to date as entries are placed
+ *			and completed. The distance is from the first entry of the list to the last, so the distance to the first
+ *			from where the head is and the distance of the entries not placed yet come on top of it.
+ *			Divided by NUMBER_OF_SG, it is the number of revolutions the planned entries take.
+ *  @param  const reorder_ctx_t *pCtx - context, unsigned *pEntries - pointer for the number of entries on the list,
+ *			unsigned *pDistance - pointer for the sum of the distances between them, in SGs
+ *  @return None
+ */
+extern	void getPlannedPathCtx(const reorder_ctx_t *pCtx, unsigned *pEntries, unsigned *pDistance);
+
+/**
+ *  @brief  Improves the work the current strategy did ahead, such as the path planned on the reordered list of
+ *			PATH_BUILDING_FROM_LBA, within the given time. Called like planReorderCtx(), after it.
+ *			Path building moves runs of 1 to IMPROVE_MAX_RUN entries to the link where they save the most distance,
+ *			keeping the order within the run, as the distances only go one way round. The first entry, which may be in flight, stays.
+ *			A call carries on from where the last one stopped, and returns at once when the list is already at a local optimum.
+ *  @param  reorder_ctx_t *pCtx - context, uint64_t budgetNs - time to stop after, in ns
+ *  @return SG distance taken out of the planned path, 0 if the strategy improves nothing
+ */
+extern	unsigned improvePlanCtx(reorder_ctx_t *pCtx, uint64_t budgetNs);
+
+/**
+ *  @brief  Sets the budget each selection of the given context has, or no budget with NULL or zeros, and clears the counters.
+ *			When a selection runs out of it, the strategy gives the best target it has found so far, and when it has found none,
+ *			the next entry in LBA is taken. A selection that runs out keeps within about SELECT_BUDGET_CLOCK_OPS operations of maxNs.
+ *			The budget covers the search of the strategy, not draining the submissions before it.
+ *  @param  reorder_ctx_t *pCtx - context, const selectBudgetConfig_t *pConfig - operations and time
+ *  @return None
+ */
+extern	void setSelectBudgetCtx(reorder_ctx_t *pCtx, const selectBudgetConfig_t *pConfig);
+
+/**
+ *  @brief  Get the selection budget counters of the given context, and whether the last selection finished within the budget
+ *  @param  const reorder_ctx_t *pCtx - context, selectBudgetStats_t *pStats - pointer for the counters
+ *  @return None
+ */
+extern	void getSelectBudgetStatsCtx(const reorder_ctx_t *pCtx, selectBudgetStats_t *pStats);
+
+/**
+ *  @brief  Turns on the online tuner of the given context, or off with NULL.
+ *			It hill-climbs the parameters the current strategy uses, one step of an eighth at a time, by comparing
+ *			the SG distance per completion of a window with the kept values against the next window with one parameter
+ *			a step off. A better trial is kept and climbed further the same way; otherwise the next parameter is tried.
+ *  @param  reorder_ctx_t *pCtx - context, const tunerConfig_t *pConfig - window and minimum gain
+ *  @return None
+ */
+extern	void setTunerCtx(reorder_ctx_t *pCtx, const tunerConfig_t *pConfig);
+
+/**
+ *  @brief  Get the tuner counters and the kept parameters of the given context. They count from setTunerCtx().
+ *  @param  const reorder_ctx_t *pCtx - context, tunerStats_t *pStats - pointer for the counters
+ *  @return None
+ */
+extern	void getTunerStatsCtx(const reorder_ctx_t *pCtx, tunerStats_t *pStats);
+
+/**
+ *  @brief  Get the governor counters and measurements of the given context. They count from setGovernorCtx().
+ *  @param  const reorder_ctx_t *pCtx - context, governorStats_t *pStats - pointer for the counters
+ *  @return None
+ */
+extern	void getGovernorStatsCtx(const reorder_ctx_t *pCtx, governorStats_t *pStats);
+
 /**
  *  @brief  Add an entry with the given LBA into the master TAVL tree (cacheMgmt.tavl.root) and SG TAVL tree (pSgTavl[sg].root).
- *  @param  unsigned lba : LBA (Python application will always send an LBA that does not overlap) 
+ *  @param  reorder_ctx_t *pCtx - context
+ *			unsigned lba : LBA (Python application will always send an LBA that does not overlap) 
  *			unsigned num_of_blocks : Number of blocks (Python lib will always set this to 1)
+ *  @return handle of the entry, to be given to completeHandleCtx(), REORDER_INVALID_HANDLE if the pool is full
+ */
+extern	reorder_handle_t addLbaCtx(reorder_ctx_t *pCtx, unsigned lba, unsigned num_of_blocks);
+
+/**
+ *  @brief  Add an entry with the given LBA and the given tag. Same as addLbaCtx() otherwise.
+ *			The tag is kept with the entry and given back by selectTargetHandleCtx(), so the caller does not need
+ *			its own map from LBA to request.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned lba - LBA, unsigned num_of_blocks - number of blocks,
+ *			uint64_t tag - caller's cookie, such as a request pointer
+ *  @return handle of the entry, to be given to completeHandleCtx(), REORDER_INVALID_HANDLE if the pool is full
+ */
+extern	reorder_handle_t addLbaTaggedCtx(reorder_ctx_t *pCtx, unsigned lba, unsigned num_of_blocks, uint64_t tag);
+
+/**
+ *  @brief  Add an entry as addLbaTaggedCtx() does, unless admission is closed or the pool is full.
+ *			Lets the host hold back or shed load instead of over-provisioning maxNode.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned lba - LBA, unsigned num_of_blocks - number of blocks,
+ *			uint64_t tag - caller's cookie kept with the entry, reorder_handle_t *pHandle - pointer for the handle or NULL
+ *  @return REORDER_ADMITTED, or REORDER_BUSY or REORDER_FULL if the entry was not added
+ */
+extern	unsigned tryAddLbaCtx(reorder_ctx_t *pCtx, unsigned lba, unsigned num_of_blocks, uint64_t tag, reorder_handle_t *pHandle);
+
+/**
+ *  @brief  Sets the admission watermarks of the given context. Admission closes when the pending entries reach
+ *			the high watermark and opens again when they fall to the low watermark; tryAddLbaCtx() and the draining
+ *			of submissions hold off in between, while addLbaCtx() still adds up to the size of the pool.
+ *			The watermarks are checked right away against the pending entries.
+ *  @param  reorder_ctx_t *pCtx - context, const admissionConfig_t *pConfig - watermarks, NULL to always admit
+ *  @return None
+ */
+extern	void setAdmissionCtx(reorder_ctx_t *pCtx, const admissionConfig_t *pConfig);
+
+/**
+ *  @brief  Get the admission counters of the given context. They count from initCacheCtx().
+ *  @param  const reorder_ctx_t *pCtx - context, admissionStats_t *pStats - pointer for the counters
+ *  @return None
+ */
+extern	void getAdmissionStatsCtx(const reorder_ctx_t *pCtx, admissionStats_t *pStats);
+
+/**
+ *  @brief  Queue an entry with the given LBA to be added by the scheduler thread before its next selection.
+ *			Lock-free and safe to call from any number of threads at the same time as the scheduler thread uses the context.
+ *			Like addLbaCtx(), the LBA must not overlap with any entry already added or queued.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned lba - LBA, unsigned num_of_blocks - number of blocks,
+ *			uint64_t tag - caller's cookie kept with the entry
+ *  @return true if queued, false if the ring is full
+ */
+extern	bool submitLbaCtx(reorder_ctx_t *pCtx, unsigned lba, unsigned num_of_blocks, uint64_t tag);
+
+/**
+ *  @brief  Add the entries queued by submitLbaCtx(), in the order they were queued, as long as the pool has room
+ *			and admission is open.
+ *			Called by selectTargetFromCurrentCtx() before each selection, so the scheduler thread does not have to call it.
+ *			Must be called only from the thread that uses the context.
+ *  @param  reorder_ctx_t *pCtx - context
+ *  @return Number of entries added
+ */
+extern	unsigned drainSubmissionsCtx(reorder_ctx_t *pCtx);
+
+/**
+ *  @brief  Sorts the given segments in LBA with an LSD radix sort.
+ *  @param  segment_t **ppSeg - segments, sorted on return, segment_t **ppTemp - work array of the same size, unsigned n - number of segments
  *  @return None
  */
-extern	void addLba(unsigned lba, unsigned num_of_blocks);
+extern	void radixSortSegments(segment_t **ppSeg, segment_t **ppTemp, unsigned n);
+
+/**
+ *  @brief  Add the given entries at once. Same result as calling addLbaCtx() for each of them in order.
+ *			The entries are sorted in LBA (radix sort, skipped if already sorted) and in SG, then the master tree
+ *			and every SG container touched are rebuilt perfectly balanced out of the existing and the new nodes.
+ *			A batch too small for the tree already built is added one by one instead.
+ *			When the pool fills up, the entries from there on are not added.
+ *  @param  reorder_ctx_t *pCtx - context, const unsigned *lbas - LBAs, none overlapping,
+ *			const unsigned *blocks - number of blocks of each entry or NULL for 1 block each, size_t n - number of entries
+ *  @return Number of entries added, the first ones of the given entries
+ */
+extern	size_t addLbaBatchCtx(reorder_ctx_t *pCtx, const unsigned *lbas, const unsigned *blocks, size_t n);
 
 /**
  *  @brief  Get distance (in number of SGs) from the startSg, startTrack to the pTargetNode
- *  @param  unsigned startSg - starting SG, unsigned startTrack- starting track, 
+ *  @param  reorder_ctx_t *pCtx - context, whose seek profile is used
+ *			unsigned startSg - starting SG, unsigned startTrack- starting track, 
  *			unsigned targetSg - target SG, unsigned targetTrack- target track, 
  *			unsigned *pDistance - pointer for the distance
  *  @return None
  */
-extern	void getDistance(unsigned startSg, unsigned startTrack, unsigned targetSg, unsigned targetTrack, unsigned *pDistance);
+extern	void getDistanceCtx(reorder_ctx_t *pCtx, unsigned startSg, unsigned startTrack, unsigned targetSg, unsigned targetTrack, unsigned *pDistance);
+
+/**
+ *  @brief  Get distance (in number of SGs) from the startSg, startTrack to the targetSg, targetTrack without a function call.
+ *			Same as getDistanceCtx() but the result is returned, and not checked against SEEK_TIME_LIMIT.
+ *			The distance is the angular distance plus as many revolutions as the seek needs on top of it.
+ *  @param  reorder_ctx_t *pCtx - context, whose seek profile is used
+ *			unsigned startSg - starting SG, unsigned startTrack- starting track, 
+ *			unsigned targetSg - target SG, unsigned targetTrack- target track
+ *  @return the distance
+ */
+static inline unsigned getDistanceFast(const reorder_ctx_t *pCtx, unsigned startSg, unsigned startTrack, unsigned targetSg, unsigned targetTrack) {
+	unsigned 	sgDiff, trackDiff, minSgDiff;
+
+	// If startSg==targetSg, it will take a revolution from startSg to targetSg
+	sgDiff=(targetSg>startSg)?(targetSg-startSg):(targetSg+NUMBER_OF_SG-startSg);
+	trackDiff=(targetTrack>=startTrack)?(targetTrack-startTrack):(startTrack-targetTrack);
+	minSgDiff=pCtx->pSeekProfile[trackDiff];
+	if (minSgDiff>sgDiff) {
+		sgDiff+=((minSgDiff-sgDiff+NUMBER_OF_SG-1)/NUMBER_OF_SG)*NUMBER_OF_SG;
+	}
+	return sgDiff;
+}
 
 /**
- *  @brief  Search the target from the current location set in cacheMgmt.
- *			Return the target.
- *  @param  unsigned *pDistance - pointer for the distance
- *  @return the target node
+ *  @brief  Get distances (in number of SGs) from one source to many targets - same result as getDistanceCtx() for each target.
+ *			Dispatches to the AVX2, SSE4.1 or scalar implementation, whichever the CPU supports, on the first call.
+ *  @param  reorder_ctx_t *pCtx - context, whose seek profile is used
+ *			unsigned srcSg - source SG, unsigned srcTrack - source track,
+ *			const uint16_t *sg - target SGs, const uint16_t *track - target tracks, unsigned n - number of targets,
+ *			unsigned *out - distances for each target
+ *  @return None
  */
-extern tavl_node_t *selectTargetFromCurrent(unsigned *pDistance);
+extern	void getDistanceBatchCtx(const reorder_ctx_t *pCtx, unsigned srcSg, unsigned srcTrack, const uint16_t *sg, const uint16_t *track, unsigned n, unsigned *out);
 
 /**
- *  @brief  Search the target from the current location set in cacheMgmt and write the LBA to the given pointer.
- *  @param  unsigned *pTargetLba - pointer for the target LBA
+ *  @brief  Implementations of getDistanceBatchCtx(). Use getDistanceBatchCtx() unless a specific one needs to be measured.
+ *			getDistanceBatchSse4() and getDistanceBatchAvx2() must be called only if the CPU supports them (see getDistanceBatchImpl()).
+ *  @param  Same as getDistanceBatchCtx()
+ *  @return None
+ */
+extern	void getDistanceBatchScalar(const reorder_ctx_t *pCtx, unsigned srcSg, unsigned srcTrack, const uint16_t *sg, const uint16_t *track, unsigned n, unsigned *out);
+extern	void getDistanceBatchSse4(const reorder_ctx_t *pCtx, unsigned srcSg, unsigned srcTrack, const uint16_t *sg, const uint16_t *track, unsigned n, unsigned *out);
+extern	void getDistanceBatchAvx2(const reorder_ctx_t *pCtx, unsigned srcSg, unsigned srcTrack, const uint16_t *sg, const uint16_t *track, unsigned n, unsigned *out);
+
+/**
+ *  @brief  Get the name of the getDistanceBatchCtx() implementation picked for this CPU
+ *  @param  None
+ *  @return "avx2", "sse4" or "scalar"
+ */
+extern	const char *getDistanceBatchImpl(void);
+
+/**
+ *  @brief  Search the target from the current location set in cacheMgmt of the given context, after draining the submission ring.
+ *			Return the target. While admission is closed with admissionConfig_t.sawtoothWhenClosed, it is the next entry in LBA.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned *pDistance - pointer for the distance
+ *  @return the segment of the target
+ */
+extern segment_t *selectTargetFromCurrentCtx(reorder_ctx_t *pCtx, unsigned *pDistance);
+
+/**
+ *  @brief  Search the target from the current location set in cacheMgmt of the given context and write the LBA to the given pointer.
+ *  @param  reorder_ctx_t *pCtx - context
+ *			unsigned *pTargetLba - pointer for the target LBA
  *			unsigned *pDistance - pointer for the distance
  *  @return None
  */
-extern void selectTargetLba(unsigned *pTargetLba, unsigned *pDistance);
+extern void selectTargetLbaCtx(reorder_ctx_t *pCtx, unsigned *pTargetLba, unsigned *pDistance);
+
+/**
+ *  @brief  Search the target from the current location set in cacheMgmt of the given context and write its handle and tag.
+ *  @param  reorder_ctx_t *pCtx - context
+ *			reorder_handle_t *pHandle - pointer for the handle of the target
+ *			uint64_t *pTag - pointer for the tag of the target, or NULL
+ *			unsigned *pDistance - pointer for the distance
+ *  @return None
+ */
+extern void selectTargetHandleCtx(reorder_ctx_t *pCtx, reorder_handle_t *pHandle, uint64_t *pTag, unsigned *pDistance);
 
 /**
  *  @brief  Remove the node with the given LBA (Caller completed the operation to the target LBA)
  *			Update the current to the given target
  *			Note that the node is not given so the node needs to be searched using the target LBA.
- *  @param  unsigned targetLba - LBA of the target
+ *  @param  reorder_ctx_t *pCtx - context, unsigned targetLba - LBA of the target
  *  @return None
  */
-extern	void completeTarget(unsigned targetLba);
+extern	void completeTargetCtx(reorder_ctx_t *pCtx, unsigned targetLba);
 
+/**
+ *  @brief  Same as completeTargetCtx() for the entry of the given handle, without searching the tree for it.
+ *  @param  reorder_ctx_t *pCtx - context, reorder_handle_t handle - handle of a pending entry
+ *  @return None
+ */
+extern	void completeHandleCtx(reorder_ctx_t *pCtx, reorder_handle_t handle);
+
+/**
+ *  @brief  Get the LBA of the entry of the given handle
+ *  @param  reorder_ctx_t *pCtx - context, reorder_handle_t handle - handle of a pending entry
+ *  @return LBA
+ */
+extern	unsigned getHandleLbaCtx(const reorder_ctx_t *pCtx, reorder_handle_t handle);
 
 /**
- *  @brief  Initializes the whole cache management structure - cacheMgmt, 
- *  @param  int maxNode - number of nodes
+ *  @brief  Get the handle of the pending entry with the given LBA, in O(1)
+ *  @param  const reorder_ctx_t *pCtx - context, unsigned lba - LBA, reorder_handle_t *pHandle - pointer for the handle
+ *  @return true if there is a pending entry with the LBA
+ */
+extern	bool getLbaHandleCtx(const reorder_ctx_t *pCtx, unsigned lba, reorder_handle_t *pHandle);
+
+/**
+ *  @brief  Complete the given targets in order, as calling completeTargetCtx() for each of them would.
+ *			The targets are unlinked from the threads first and the trees rebuilt balanced once at the end.
+ *			A batch too small for the tree is completed one by one instead.
+ *  @param  reorder_ctx_t *pCtx - context, const unsigned *lbas - LBAs of the targets, size_t n - number of targets
  *  @return None
  */
+extern	void completeTargetBatchCtx(reorder_ctx_t *pCtx, const unsigned *lbas, size_t n);
+
+//-----------------------------------------------------------
+// Public Functions over the default context, used by python lib
+// Each one is the ...Ctx() function of the same name called with getDefaultReorderCtx().
+//-----------------------------------------------------------
+/**
+ *  @brief  Get the default context used by the functions below
+ *  @param  None
+ *  @return the default context
+ */
+extern	reorder_ctx_t *getDefaultReorderCtx(void);
+
 extern	void initCache(int maxNode);
+extern	reorder_handle_t addLba(unsigned lba, unsigned num_of_blocks);
+extern	reorder_handle_t addLbaTagged(unsigned lba, unsigned num_of_blocks, uint64_t tag);
+extern	unsigned tryAddLba(unsigned lba, unsigned num_of_blocks, uint64_t tag, reorder_handle_t *pHandle);
+extern	void setAdmission(const admissionConfig_t *pConfig);
+extern	void getAdmissionStats(admissionStats_t *pStats);
+extern	void setGovernor(const governorConfig_t *pConfig);
+extern	void getGovernorStats(governorStats_t *pStats);
+extern	bool setTuning(unsigned param, unsigned value);
+extern	void setTuner(const tunerConfig_t *pConfig);
+extern	bool setLookahead(unsigned depth, unsigned width);
+extern	bool setWindowDp(unsigned window, unsigned depth, unsigned hops);
+extern	void setPlanner(bool on);
+extern	unsigned planReorder(unsigned maxEntries);
+extern	bool startPlanner(const plannerConfig_t *pConfig);
+extern	void stopPlanner(void);
+extern	void getPlannerStats(plannerStats_t *pStats);
+extern	void getPlannedPath(unsigned *pEntries, unsigned *pDistance);
+extern	unsigned improvePlan(uint64_t budgetNs);
+extern	void setSelectBudget(const selectBudgetConfig_t *pConfig);
+extern	void getSelectBudgetStats(selectBudgetStats_t *pStats);
+extern	void getTunerStats(tunerStats_t *pStats);
+extern	void getDistance(unsigned startSg, unsigned startTrack, unsigned targetSg, unsigned targetTrack, unsigned *pDistance);
+extern	void getDistanceBatch(unsigned srcSg, unsigned srcTrack, const uint16_t *sg, const uint16_t *track, unsigned n, unsigned *out);
+extern	segment_t *selectTargetFromCurrent(unsigned *pDistance);
+extern	void selectTargetLba(unsigned *pTargetLba, unsigned *pDistance);
+extern	void selectTargetHandle(reorder_handle_t *pHandle, uint64_t *pTag, unsigned *pDistance);
+extern	void completeTarget(unsigned targetLba);
+extern	void completeHandle(reorder_handle_t handle);
+extern	size_t addLbaBatch(const unsigned *lbas, const unsigned *blocks, size_t n);
+extern	void completeTargetBatch(const unsigned *lbas, size_t n);
+extern	unsigned shrinkPool(void);
+extern	void setReorderStrategy(const reorderStrategy_t *pStrategy);
 
 extern	void tavlSanityCheck(tavl_t *pTavl);
-extern	void tavlSanityCheckSub(tavl_t *pTavl);
-extern  bool tavlHeightCheck(tavl_node_t *head);
+extern  bool tavlHeightCheck(const tavl_t *pTavl, segIdx_t head);
 
 #endif // _REORDER_H_
@@ -50,6 +50,65 @@ class reorderLibOperator:
         _reorderLib.addLba(ctypes.c_int(lba),1)
         return
 
+    def tryAddLba(self, lba, tag=0):
+        global _reorderLib
+        handle=(ctypes.c_uint32*1)()
+        status=_reorderLib.tryAddLba(ctypes.c_uint(lba), 1, ctypes.c_uint64(tag), handle)
+        return status, handle[0]
+
+    def setStrategy(self, strategy):
+        global _reorderLib
+        _reorderLib.getReorderStrategy.restype = ctypes.c_void_p
+        pStrategy = _reorderLib.getReorderStrategy(ctypes.c_uint(strategy))
+        if pStrategy is None:
+            raise ValueError("No reordering strategy %d" % strategy)
+        _reorderLib.setReorderStrategy(ctypes.c_void_p(pStrategy))
+        return
+
+    def setLookahead(self, depth, width):
+        global _reorderLib
+        _reorderLib.setLookahead.restype = ctypes.c_bool
+        if not _reorderLib.setLookahead(ctypes.c_uint(depth), ctypes.c_uint(width)):
+            raise ValueError("No lookahead of depth %d and width %d" % (depth, width))
+        return
+
+    def startPlanner(self, batch=0):
+        global _reorderLib
+        _reorderLib.startPlanner.restype = ctypes.c_bool
+        config=(ctypes.c_uint*1)(batch)
+        return _reorderLib.startPlanner(config)
+
+    def stopPlanner(self):
+        global _reorderLib
+        _reorderLib.stopPlanner()
+        return
+
+    def setWindowDp(self, window, depth, hops):
+        global _reorderLib
+        _reorderLib.setWindowDp.restype = ctypes.c_bool
+        if not _reorderLib.setWindowDp(ctypes.c_uint(window), ctypes.c_uint(depth), ctypes.c_uint(hops)):
+            raise ValueError("No window DP of window %d, depth %d and hops %d" % (window, depth, hops))
+        return
+
+    def getPlannedPath(self):
+        global _reorderLib
+        entries=(ctypes.c_uint*1)()
+        distance=(ctypes.c_uint*1)()
+        _reorderLib.getPlannedPath(entries, distance)
+        return entries[0], distance[0]
+
+    def improvePlan(self, budget_ns):
+        global _reorderLib
+        _reorderLib.improvePlan.restype = ctypes.c_uint
+        return _reorderLib.improvePlan(ctypes.c_uint64(budget_ns))
+
+    def addLbaBatch(self, lbas):
+        global _reorderLib
+        n = len(lbas)
+        lbaArray = (ctypes.c_uint*n)(*[int(lba) for lba in lbas])
+        _reorderLib.addLbaBatch(lbaArray, None, ctypes.c_size_t(n))
+        return
+
     def getDistance(self, curr_lba, new_lba):
         global _reorderLib
         currSg=(ctypes.c_int*1)()
@@ -79,7 +138,20 @@ class reorderLibOperator:
         _reorderLib.selectTargetLba(pTargetLba, pDistance)
         return targetLba[0], distance[0]
 
+    def selectTargetHandle(self):
+        global _reorderLib
+        handle=(ctypes.c_uint32*1)()
+        tag=(ctypes.c_uint64*1)()
+        distance=(ctypes.c_int*1)()
+        _reorderLib.selectTargetHandle(handle, tag, distance)
+        return handle[0], tag[0], distance[0]
+
     def completeLba(self, lba):
         global _reorderLib
         _reorderLib.completeTarget(lba)
         return
+
+    def completeHandle(self, handle):
+        global _reorderLib
+        _reorderLib.completeHandle(ctypes.c_uint32(handle))
+        return
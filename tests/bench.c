@@ -0,0 +1,895 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "../reorderLib.h"
+#define NUM_OF_BENCH_NODES		(10000)
+#define DISTANCE_BENCH_PAIRS	(10000000)	// 10^7 pairs
+#define DISTANCE_BENCH_BATCH	(1000)		// Targets per source
+#define SUBMIT_BENCH_MAX_PRODUCERS	(32)
+#define SUBMIT_BENCH_NS			(1000000000ULL)	// Duration of each run
+#define SUBMIT_BENCH_MAX_SAMPLES	(8000000)
+#define BATCH_BENCH_MAX_NODES	(1000000)
+#define TREE_BENCH_MAX_NODES	(100000)
+#define TREE_BENCH_OPS			(200000)	// Removals and insertions each, per queue depth
+#define TREE_BENCH_CHUNK		(100)		// Removals, then insertions, timed together
+#define POOL_BENCH_MAX_NODES	(10000000)
+#define POOL_BENCH_ADDS			(100000)	// Entries added to each context, at most maxNode
+#define SELECT_BENCH_MAX_NODES	(100000)
+#define SELECT_BENCH_OPS		(20000)		// Selections per strategy, per queue depth
+
+#define BUDGET_BENCH_OPS		(20000)		// Selections per strategy, queue depth and budget
+#define PLAN_BENCH_MAX_NODES	(1000)
+#define PLAN_BENCH_OPS			(5000)		// Selections per queue depth and mode
+#define PLAN_BENCH_IO_NS		(100000)	// Time each I/O is in flight for the planner thread to plan in
+#define INSERT_BENCH_MAX_NODES	(4000)
+#define INSERT_BENCH_OPS		(2000)		// Entries placed per queue depth, one per selection
+#define IMPROVE_BENCH_OPS		(5000)		// Selections per queue depth and budget
+#define IMPROVE_BENCH_BUDGETS	(3)
+#define WINDOW_BENCH_MAX_NODES	(10000)
+#define WINDOW_BENCH_OPS		(10000)		// Selections per configuration and queue depth
+
+// Depth and width of the lookahead runs of benchSelect()
+static const unsigned	lookaheadBenchConfig[][2]={ { 2, 2 }, { 2, 4 }, { 3, 4 }, { 4, 2 }, { 2, 8 } };
+// Window, depth and hops of the window DP runs of benchWindow(), after shortest distance as window 0
+static const unsigned	windowBenchConfig[][3]={ { 0, 0, 0 }, { 4, 4, 4 }, { 8, 8, 8 }, { 12, 12, 12 }, { 8, 4, 1 }, { 8, 8, 1 }, { 12, 4, 2 }, { 12, 12, 6 } };
+// Budgets of benchBudget(), the first none
+static const selectBudgetConfig_t	budgetBenchConfig[]={ { 0, 0 }, { 256, 0 }, { 64, 0 }, { 0, 4000 }, { 0, 1000 } };
+
+/**
+ *  @brief  Get monotonic time in nano seconds
+ *  @param  None
+ *  @return time in nano seconds
+ */
+uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec;
+}
+
+/**
+ *  @brief  Compare getDistanceBatchCtx() implementations against the scalar getDistanceCtx() over DISTANCE_BENCH_PAIRS pairs.
+ *			Each source is paired with DISTANCE_BENCH_BATCH targets.
+ *  @param  None
+ *  @return None
+ */
+void benchDistance(void) {
+	uint16_t	*sg, *track, *srcSg, *srcTrack;
+	unsigned	*out, *expected;
+	unsigned	i, j, numberOfSources;
+	uint64_t	start, scalarNs, fastNs, ns;
+	const char	*impl;
+	reorder_ctx_t	*pCtx;
+	struct {
+		const char	*name;
+		void		(*fn)(const reorder_ctx_t *, unsigned, unsigned, const uint16_t *, const uint16_t *, unsigned, unsigned *);
+	} batchImpl[]={
+		{"scalar", getDistanceBatchScalar},
+		{"sse4", getDistanceBatchSse4},
+		{"avx2", getDistanceBatchAvx2},
+		{"dispatched", getDistanceBatchCtx},
+	};
+
+	pCtx=createReorderCtx(NUM_OF_BENCH_NODES);
+	impl=getDistanceBatchImpl();
+	numberOfSources=DISTANCE_BENCH_PAIRS/DISTANCE_BENCH_BATCH;
+	sg=malloc(DISTANCE_BENCH_PAIRS*sizeof(uint16_t));
+	track=malloc(DISTANCE_BENCH_PAIRS*sizeof(uint16_t));
+	srcSg=malloc(numberOfSources*sizeof(uint16_t));
+	srcTrack=malloc(numberOfSources*sizeof(uint16_t));
+	out=malloc(DISTANCE_BENCH_PAIRS*sizeof(unsigned));
+	expected=malloc(DISTANCE_BENCH_PAIRS*sizeof(unsigned));
+	assert(sg && track && srcSg && srcTrack && out && expected);
+	for (i=0; i<DISTANCE_BENCH_PAIRS; i++) {
+		sg[i]=rand()%NUMBER_OF_SG;
+		track[i]=rand()%NUMBER_OF_TRACKS;
+	}
+	for (j=0; j<numberOfSources; j++) {
+		srcSg[j]=rand()%NUMBER_OF_SG;
+		srcTrack[j]=rand()%NUMBER_OF_TRACKS;
+	}
+
+	start=nowNs();
+	for (j=0; j<numberOfSources; j++) {
+		for (i=j*DISTANCE_BENCH_BATCH; i<(j+1)*DISTANCE_BENCH_BATCH; i++) {
+			getDistanceCtx(pCtx, srcSg[j], srcTrack[j], sg[i], track[i], &expected[i]);
+		}
+	}
+	scalarNs=nowNs()-start;
+	printf("getDistanceCtx()   : %.3f ns/pair\n", (double)scalarNs/DISTANCE_BENCH_PAIRS);
+
+	start=nowNs();
+	for (j=0; j<numberOfSources; j++) {
+		for (i=j*DISTANCE_BENCH_BATCH; i<(j+1)*DISTANCE_BENCH_BATCH; i++) {
+			out[i]=getDistanceFast(pCtx, srcSg[j], srcTrack[j], sg[i], track[i]);
+		}
+	}
+	fastNs=nowNs()-start;
+	assert(0==memcmp(out, expected, DISTANCE_BENCH_PAIRS*sizeof(unsigned)));
+	printf("getDistanceFast()  : %.3f ns/pair, %.2fx\n", (double)fastNs/DISTANCE_BENCH_PAIRS, (double)scalarNs/fastNs);
+
+	for (i=0; i<sizeof(batchImpl)/sizeof(batchImpl[0]); i++) {
+		// Skip the implementations this CPU does not support
+		if ((0==strcmp(batchImpl[i].name, "avx2")) && strcmp(impl, "avx2")) {
+			continue;
+		}
+		if ((0==strcmp(batchImpl[i].name, "sse4")) && (0==strcmp(impl, "scalar"))) {
+			continue;
+		}
+		memset(out, 0, DISTANCE_BENCH_PAIRS*sizeof(unsigned));
+		start=nowNs();
+		for (j=0; j<numberOfSources; j++) {
+			batchImpl[i].fn(pCtx, srcSg[j], srcTrack[j], &sg[j*DISTANCE_BENCH_BATCH], &track[j*DISTANCE_BENCH_BATCH], DISTANCE_BENCH_BATCH, &out[j*DISTANCE_BENCH_BATCH]);
+		}
+		ns=nowNs()-start;
+		assert(0==memcmp(out, expected, DISTANCE_BENCH_PAIRS*sizeof(unsigned)));
+		printf("getDistanceBatch() : %-10s %.3f ns/pair, %.2fx\n", batchImpl[i].name, (double)ns/DISTANCE_BENCH_PAIRS, (double)scalarNs/ns);
+	}
+
+	free(sg);
+	free(track);
+	free(srcSg);
+	free(srcTrack);
+	free(out);
+	free(expected);
+	destroyReorderCtx(pCtx);
+}
+
+typedef struct submitBench {
+	reorder_ctx_t	*pCtx;
+	unsigned		producer;
+	unsigned		numberOfProducers;
+	volatile bool	*pStop;
+	uint64_t		submitted;
+	uint64_t		rejected;
+} submitBench_t;
+
+/**
+ *  @brief  Get a unique LBA for the given submission of the given producer.
+ *			Scrambles the submission index with a bijection on 28 bits and skips the ones beyond the disk,
+ *			so LBAs do not repeat as long as the index stays below 2^28.
+ *  @param  unsigned producer - producer index, unsigned numberOfProducers - number of producers, uint64_t *pIndex - submission index, advanced
+ *  @return LBA
+ */
+unsigned getSubmitBenchLba(unsigned producer, unsigned numberOfProducers, uint64_t *pIndex) {
+	uint32_t	x;
+
+	do {
+		x=(uint32_t)((*pIndex)*numberOfProducers+producer);
+		(*pIndex)++;
+		assert(x<(1u<<28));
+		x=(x*0x9E3779B1u)&0x0fffffff;
+		x^=(x>>14);
+	} while (x>=NUMBER_OF_BLOCKS);
+	return x;
+}
+
+/**
+ *  @brief  Producer thread of benchSubmit(). Submits until stopped, yielding while the ring is full.
+ *  @param  void *arg - submitBench_t of the producer
+ *  @return NULL
+ */
+void *runSubmitBenchProducer(void *arg) {
+	submitBench_t	*pBench=(submitBench_t *)arg;
+	uint64_t		index=0;
+	unsigned		lba;
+
+	lba=getSubmitBenchLba(pBench->producer, pBench->numberOfProducers, &index);
+	while (!*pBench->pStop) {
+		if (submitLbaCtx(pBench->pCtx, lba, 1, index)) {
+			pBench->submitted++;
+			lba=getSubmitBenchLba(pBench->producer, pBench->numberOfProducers, &index);
+		} else {
+			pBench->rejected++;
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+int compareU32(const void *a, const void *b) {
+	uint32_t x=*(const uint32_t *)a, y=*(const uint32_t *)b;
+	return (x>y)-(x<y);
+}
+
+/**
+ *  @brief  Stress the submission ring with 1 to SUBMIT_BENCH_MAX_PRODUCERS producer threads while this thread schedules,
+ *			and report submissions per second and the selection latency percentiles.
+ *			The selection latency is of selectTargetLbaCtx(), which includes draining the ring.
+ *			The library logs to stdout on every selection, so stdout is discarded while measuring.
+ *  @param  None
+ *  @return None
+ */
+void benchSubmit(void) {
+	submitBench_t	bench[SUBMIT_BENCH_MAX_PRODUCERS];
+	pthread_t		thread[SUBMIT_BENCH_MAX_PRODUCERS];
+	volatile bool	stop;
+	reorder_ctx_t	*pCtx;
+	uint32_t		*pLatency;
+	uint64_t		start, end, t0, submitted, rejected, selections;
+	unsigned		numberOfProducers, i, targetLba, dist;
+	int				savedStdout, devNull, ret;
+
+	pLatency=malloc(SUBMIT_BENCH_MAX_SAMPLES*sizeof(uint32_t));
+	assert(NULL!=pLatency);
+	printf("%9s %14s %14s %10s %8s %8s %8s %8s %8s\n", "producers", "submissions/s", "ring full/s", "selections", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+	for (numberOfProducers=1; numberOfProducers<=SUBMIT_BENCH_MAX_PRODUCERS; numberOfProducers<<=1) {
+		pCtx=createReorderCtx(NUM_OF_BENCH_NODES);
+		stop=false;
+		for (i=0; i<numberOfProducers; i++) {
+			bench[i].pCtx=pCtx;
+			bench[i].producer=i;
+			bench[i].numberOfProducers=numberOfProducers;
+			bench[i].pStop=&stop;
+			bench[i].submitted=0;
+			bench[i].rejected=0;
+		}
+
+		fflush(stdout);
+		savedStdout=dup(1);
+		devNull=open("/dev/null", O_WRONLY);
+		assert((savedStdout>=0) && (devNull>=0));
+		dup2(devNull, 1);
+
+		for (i=0; i<numberOfProducers; i++) {
+			ret=pthread_create(&thread[i], NULL, runSubmitBenchProducer, &bench[i]);
+			assert(0==ret);
+		}
+		selections=0;
+		start=nowNs();
+		do {
+			// Wait for the producers to give something to select
+			if ((0==drainSubmissionsCtx(pCtx)) && (0==pCtx->cacheMgmt.tavl.active_nodes)) {
+				end=nowNs();
+				continue;
+			}
+			t0=nowNs();
+			selectTargetLbaCtx(pCtx, &targetLba, &dist);
+			end=nowNs();
+			completeTargetCtx(pCtx, targetLba);
+			if (selections<SUBMIT_BENCH_MAX_SAMPLES) {
+				pLatency[selections]=(uint32_t)(end-t0);
+			}
+			selections++;
+		} while (end-start<SUBMIT_BENCH_NS);
+		stop=true;
+		for (i=0; i<numberOfProducers; i++) {
+			ret=pthread_join(thread[i], NULL);
+			assert(0==ret);
+		}
+		end=nowNs();
+
+		fflush(stdout);
+		dup2(savedStdout, 1);
+		close(savedStdout);
+		close(devNull);
+
+		submitted=rejected=0;
+		for (i=0; i<numberOfProducers; i++) {
+			submitted+=bench[i].submitted;
+			rejected+=bench[i].rejected;
+		}
+		selections=MIN(selections, SUBMIT_BENCH_MAX_SAMPLES);
+		assert(0!=selections);
+		qsort(pLatency, selections, sizeof(uint32_t), compareU32);
+		printf("%9u %14.0f %14.0f %10lu %8.2f %8.2f %8.2f %8.2f %8.2f\n", numberOfProducers,
+			(double)submitted*1e9/(end-start), (double)rejected*1e9/(end-start), (unsigned long)selections,
+			pLatency[selections*50/100]/1e3, pLatency[selections*90/100]/1e3, pLatency[selections*99/100]/1e3,
+			pLatency[selections*999/1000]/1e3, pLatency[selections-1]/1e3);
+		destroyReorderCtx(pCtx);
+	}
+	free(pLatency);
+}
+
+/**
+ *  @brief  Compare priming a context with addLbaCtx() one by one against addLbaBatchCtx() with unsorted and sorted LBAs,
+ *			and draining it with completeTargetCtx() against completeTargetBatchCtx(), from 1000 to BATCH_BENCH_MAX_NODES nodes.
+ *  @param  None
+ *  @return None
+ */
+void benchBatch(void) {
+	unsigned	*lbas, *sortedLbas;
+	unsigned	n, i, j, tmp, stride;
+	uint64_t	start, addNs, batchNs, sortedBatchNs, completeNs, batchCompleteNs;
+	reorder_ctx_t	*pCtx;
+	int			savedStdout, devNull;
+
+	lbas=malloc(BATCH_BENCH_MAX_NODES*sizeof(unsigned));
+	sortedLbas=malloc(BATCH_BENCH_MAX_NODES*sizeof(unsigned));
+	assert((NULL!=lbas) && (NULL!=sortedLbas));
+	printf("%8s %12s %12s %12s %12s %12s\n", "nodes", "addLba ms", "batch ms", "sorted ms", "complete ms", "batch ms");
+	for (n=1000; n<=BATCH_BENCH_MAX_NODES; n*=10) {
+		// One random LBA in each 1/n of the device, shuffled
+		stride=NUMBER_OF_BLOCKS/n;
+		for (i=0; i<n; i++) {
+			sortedLbas[i]=i*stride+(unsigned)rand()%stride;
+			lbas[i]=sortedLbas[i];
+		}
+		for (i=n-1; i>0; i--) {
+			j=(unsigned)rand()%(i+1);
+			tmp=lbas[i];
+			lbas[i]=lbas[j];
+			lbas[j]=tmp;
+		}
+
+		fflush(stdout);
+		savedStdout=dup(1);
+		devNull=open("/dev/null", O_WRONLY);
+		assert((savedStdout>=0) && (devNull>=0));
+		dup2(devNull, 1);
+
+		pCtx=createReorderCtx(n);
+		start=nowNs();
+		for (i=0; i<n; i++) {
+			addLbaCtx(pCtx, lbas[i], 1);
+		}
+		addNs=nowNs()-start;
+		start=nowNs();
+		for (i=0; i<n; i++) {
+			completeTargetCtx(pCtx, sortedLbas[i]);
+		}
+		completeNs=nowNs()-start;
+		destroyReorderCtx(pCtx);
+
+		pCtx=createReorderCtx(n);
+		start=nowNs();
+		addLbaBatchCtx(pCtx, lbas, NULL, n);
+		batchNs=nowNs()-start;
+		start=nowNs();
+		completeTargetBatchCtx(pCtx, sortedLbas, n);
+		batchCompleteNs=nowNs()-start;
+		destroyReorderCtx(pCtx);
+
+		pCtx=createReorderCtx(n);
+		start=nowNs();
+		addLbaBatchCtx(pCtx, sortedLbas, NULL, n);
+		sortedBatchNs=nowNs()-start;
+		destroyReorderCtx(pCtx);
+
+		fflush(stdout);
+		dup2(savedStdout, 1);
+		close(savedStdout);
+		close(devNull);
+		printf("%8u %12.2f %12.2f %12.2f %12.2f %12.2f\n", n, addNs/1e6, batchNs/1e6, sortedBatchNs/1e6, completeNs/1e6, batchCompleteNs/1e6);
+	}
+	free(lbas);
+	free(sortedLbas);
+}
+
+/**
+ *  @brief  Get a random LBA that is not in the given context yet.
+ *  @param  reorder_ctx_t *pCtx - context
+ *  @return LBA
+ */
+unsigned getNewBenchLba(reorder_ctx_t *pCtx) {
+	unsigned	lba;
+
+	do {
+		lba=(((unsigned)rand()<<16)^(unsigned)rand())%NUMBER_OF_BLOCKS;
+	} while (NULL_SEG_IDX!=searchAvl(&pCtx->cacheMgmt.tavl, lba));
+	return lba;
+}
+
+/**
+ *  @brief  Measure the cost of inserting into and removing from both trees at 1000 to TREE_BENCH_MAX_NODES pending segments.
+ *			Random pending segments are removed with freeNode() and as many random LBAs added with addLbaCtx(),
+ *			TREE_BENCH_CHUNK at a time, so the queue depth stays around the given number.
+ *  @param  None
+ *  @return None
+ */
+void benchTree(void) {
+	reorder_handle_t	*pHandle;
+	unsigned			*lbas, *pLookup;
+	unsigned			n, i, j, count, done;
+	uint64_t			start, insertNs, removeNs, searchNs, hashNs;
+	reorder_ctx_t		*pCtx;
+	reorder_handle_t	found;
+	uintptr_t			sum=0;
+
+	pHandle=malloc(TREE_BENCH_MAX_NODES*sizeof(reorder_handle_t));
+	lbas=malloc(TREE_BENCH_CHUNK*sizeof(unsigned));
+	pLookup=malloc(TREE_BENCH_OPS*sizeof(unsigned));
+	assert((NULL!=pHandle) && (NULL!=lbas) && (NULL!=pLookup));
+	printf("%8s %14s %14s %14s %14s\n", "nodes", "insert ns", "remove ns", "searchAvl ns", "LBA hash ns");
+	for (n=1000; n<=TREE_BENCH_MAX_NODES; n*=10) {
+		pCtx=createReorderCtx(n);
+		for (count=0; count<n; count++) {
+			pHandle[count]=addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+		}
+		insertNs=removeNs=0;
+		for (done=0; done<TREE_BENCH_OPS; done+=TREE_BENCH_CHUNK) {
+			start=nowNs();
+			for (i=0; i<TREE_BENCH_CHUNK; i++) {
+				j=(unsigned)rand()%count;
+				freeNode(pCtx, &pCtx->pSegmentPool[pHandle[j]]);
+				pHandle[j]=pHandle[--count];
+			}
+			removeNs+=nowNs()-start;
+			for (i=0; i<TREE_BENCH_CHUNK; i++) {
+				lbas[i]=getNewBenchLba(pCtx);
+			}
+			start=nowNs();
+			for (i=0; i<TREE_BENCH_CHUNK; i++) {
+				pHandle[count++]=addLbaCtx(pCtx, lbas[i], 1);
+			}
+			insertNs+=nowNs()-start;
+		}
+		assert(tavlHeightCheck(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.root));
+		// Exact lookups of random pending LBAs, through the master tree and through the LBA hash
+		for (done=0; done<TREE_BENCH_OPS; done++) {
+			pLookup[done]=getHandleLbaCtx(pCtx, pHandle[(unsigned)rand()%count]);
+		}
+		start=nowNs();
+		for (done=0; done<TREE_BENCH_OPS; done++) {
+			sum+=(uintptr_t)searchAvl(&pCtx->cacheMgmt.tavl, pLookup[done]);
+		}
+		searchNs=nowNs()-start;
+		start=nowNs();
+		for (done=0; done<TREE_BENCH_OPS; done++) {
+			sum+=getLbaHandleCtx(pCtx, pLookup[done], &found);
+		}
+		hashNs=nowNs()-start;
+		printf("%8u %14.1f %14.1f %14.1f %14.1f\n", n, (double)insertNs/TREE_BENCH_OPS, (double)removeNs/TREE_BENCH_OPS,
+			(double)searchNs/TREE_BENCH_OPS, (double)hashNs/TREE_BENCH_OPS);
+		destroyReorderCtx(pCtx);
+	}
+	assert(0!=sum);
+	free(pHandle);
+	free(lbas);
+	free(pLookup);
+}
+
+/**
+ *  @brief  Measure creating a context, adding up to POOL_BENCH_ADDS entries and destroying it, for maxNode of 1000 to POOL_BENCH_MAX_NODES.
+ *  @param  None
+ *  @return None
+ */
+void benchPool(void) {
+	unsigned		maxNode, i, n, stride;
+	uint64_t		start, createNs, addNs, destroyNs;
+	reorder_ctx_t	*pCtx;
+
+	printf("%10s %12s %12s %12s\n", "maxNode", "create us", "add ms", "destroy us");
+	for (maxNode=1000; maxNode<=POOL_BENCH_MAX_NODES; maxNode*=10) {
+		n=(maxNode<POOL_BENCH_ADDS)?maxNode:POOL_BENCH_ADDS;
+		stride=NUMBER_OF_BLOCKS/n;
+		start=nowNs();
+		pCtx=createReorderCtx(maxNode);
+		createNs=nowNs()-start;
+		start=nowNs();
+		for (i=0; i<n; i++) {
+			addLbaCtx(pCtx, i*stride, 1);
+		}
+		addNs=nowNs()-start;
+		start=nowNs();
+		destroyReorderCtx(pCtx);
+		destroyNs=nowNs()-start;
+		printf("%10u %12.1f %12.2f %12.1f\n", maxNode, createNs/1e3, addNs/1e6, destroyNs/1e3);
+	}
+}
+
+/**
+ *  @brief  Measure selectTargetLbaCtx() of the given strategy at the given number of pending segments. See benchSelect().
+ *  @param  const reorderStrategy_t *pStrategy - strategy, const char *name - name of the row, unsigned n - pending segments,
+ *			unsigned depth, unsigned width - of the lookahead
+ *  @return None
+ */
+void benchSelectRow(const reorderStrategy_t *pStrategy, const char *name, unsigned n, unsigned depth, unsigned width) {
+	unsigned				i, lba, distance;
+	uint64_t				start, ns, selectNs, maxNs, totalDist, visits;
+	reorder_ctx_t			*pCtx;
+
+	srand(n);
+	pCtx=createReorderCtx(n);
+	setReorderStrategyCtx(pCtx, pStrategy);
+	(void)setLookaheadCtx(pCtx, depth, width);
+	for (i=0; i<n; i++) {
+		addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+	}
+	selectNs=maxNs=totalDist=visits=0;
+	for (i=0; i<SELECT_BENCH_OPS; i++) {
+		visits-=pCtx->cacheMgmt.sgVisits;
+		start=nowNs();
+		selectTargetLbaCtx(pCtx, &lba, &distance);
+		ns=nowNs()-start;
+		selectNs+=ns;
+		maxNs=(ns>maxNs)?ns:maxNs;
+		visits+=pCtx->cacheMgmt.sgVisits;
+		totalDist+=distance;
+		completeTargetCtx(pCtx, lba);
+		addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+	}
+	printf("%-36s %8u %14.1f %10llu %14.2f %14.1f\n", name, n, (double)selectNs/SELECT_BENCH_OPS, (unsigned long long)maxNs,
+		(double)totalDist/SELECT_BENCH_OPS, (double)visits/SELECT_BENCH_OPS);
+	destroyReorderCtx(pCtx);
+}
+
+/**
+ *  @brief  Measure selectTargetLbaCtx() of each built-in strategy that does not keep its own order, at 100 to SELECT_BENCH_MAX_NODES pending segments.
+ *			Each selected target is completed and replaced by a random LBA outside the timing, so the queue depth stays the same.
+ *			The same LBAs are used for every strategy, and the mean distance tells whether two builds picked the same targets.
+ *			Also reports the SG tree nodes or SG array entries the selections looked at, and the slowest selection.
+ *			The lookahead runs with each depth and width of lookaheadBenchConfig.
+ *  @param  None
+ *  @return None
+ */
+void benchSelect(void) {
+	const reorderStrategy_t	*pStrategy;
+	unsigned				strategy, n, i;
+	char					name[64];
+
+	printf("%-36s %8s %14s %10s %14s %14s\n", "strategy", "nodes", "select ns", "max ns", "mean distance", "SG visits");
+	for (strategy=0; strategy<NUMBER_OF_STRATEGIES; strategy++) {
+		pStrategy=getReorderStrategy(strategy);
+		if (pStrategy->ownOrder) {
+			continue;
+		}
+		for (n=100; n<=SELECT_BENCH_MAX_NODES; n*=10) {
+			if (LOOKAHEAD!=strategy) {
+				benchSelectRow(pStrategy, pStrategy->name, n, LOOKAHEAD_DEFAULT_DEPTH, LOOKAHEAD_DEFAULT_WIDTH);
+				continue;
+			}
+			for (i=0; i<sizeof(lookaheadBenchConfig)/sizeof(lookaheadBenchConfig[0]); i++) {
+				snprintf(name, sizeof(name), "%s %ux%u", pStrategy->name, lookaheadBenchConfig[i][0], lookaheadBenchConfig[i][1]);
+				benchSelectRow(pStrategy, name, n, lookaheadBenchConfig[i][0], lookaheadBenchConfig[i][1]);
+			}
+		}
+	}
+}
+
+/**
+ *  @brief  Measure the latency percentiles of selectTargetLbaCtx() of shortest distance, shortest distance within range and
+ *			lookahead of depth 3 and width 4, at 100 and 10^4 pending segments, without a selection budget and with each of
+ *			budgetBenchConfig. Reports the mean distance, and the selections cut short by the budget and those of them that fell back.
+ *  @param  None
+ *  @return None
+ */
+void benchBudget(void) {
+	const unsigned			strategies[]={ SHORTEST_DIST, SHORTEST_DIST_WITHIN_RANGE, LOOKAHEAD };
+	uint32_t				*pLatency=malloc(BUDGET_BENCH_OPS*sizeof(uint32_t));
+	selectBudgetStats_t		stats;
+	unsigned				s, n, b, i, lba, distance;
+	uint64_t				start, selectNs, totalDist;
+	reorder_ctx_t			*pCtx;
+	char					budget[32];
+
+	assert(NULL!=pLatency);
+	printf("%-32s %8s %10s %10s %10s %10s %10s %14s %8s %8s\n", "strategy", "nodes", "budget", "mean ns", "p99 ns", "p99.9 ns", "max ns",
+		"mean distance", "cut %", "fell %");
+	for (s=0; s<sizeof(strategies)/sizeof(strategies[0]); s++) {
+		for (n=100; n<=10000; n*=100) {
+			for (b=0; b<sizeof(budgetBenchConfig)/sizeof(budgetBenchConfig[0]); b++) {
+				srand(n);
+				pCtx=createReorderCtx(n);
+				setReorderStrategyCtx(pCtx, getReorderStrategy(strategies[s]));
+				(void)setLookaheadCtx(pCtx, 3, 4);
+				for (i=0; i<n; i++) {
+					addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+				}
+				setSelectBudgetCtx(pCtx, &budgetBenchConfig[b]);
+				selectNs=totalDist=0;
+				for (i=0; i<BUDGET_BENCH_OPS; i++) {
+					start=nowNs();
+					selectTargetLbaCtx(pCtx, &lba, &distance);
+					pLatency[i]=(uint32_t)(nowNs()-start);
+					selectNs+=pLatency[i];
+					totalDist+=distance;
+					completeTargetCtx(pCtx, lba);
+					addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+				}
+				getSelectBudgetStatsCtx(pCtx, &stats);
+				qsort(pLatency, BUDGET_BENCH_OPS, sizeof(uint32_t), compareU32);
+				if (0!=budgetBenchConfig[b].maxOps) {
+					snprintf(budget, sizeof(budget), "%u ops", budgetBenchConfig[b].maxOps);
+				} else if (0!=budgetBenchConfig[b].maxNs) {
+					snprintf(budget, sizeof(budget), "%u ns", budgetBenchConfig[b].maxNs);
+				} else {
+					snprintf(budget, sizeof(budget), "none");
+				}
+				printf("%-32s %8u %10s %10.1f %10u %10u %10u %14.2f %8.2f %8.2f\n", getReorderStrategy(strategies[s])->name, n, budget,
+					(double)selectNs/BUDGET_BENCH_OPS, pLatency[BUDGET_BENCH_OPS*99/100], pLatency[BUDGET_BENCH_OPS*999/1000],
+					pLatency[BUDGET_BENCH_OPS-1], (double)totalDist/BUDGET_BENCH_OPS,
+					100.0*stats.cutShort/BUDGET_BENCH_OPS, 100.0*stats.fallbacks/BUDGET_BENCH_OPS);
+				destroyReorderCtx(pCtx);
+			}
+		}
+	}
+	free(pLatency);
+}
+
+/**
+ *  @brief  Measure the latency percentiles of selectTargetLbaCtx() of path building at 250 to PLAN_BENCH_MAX_NODES pending segments,
+ *			filling the reordered list in the selection, and planned with planReorderCtx() after every completion and new entry.
+ *			Reports the planning time per selection, outside the selection, and the mean distance, the same for both.
+ *			With the planner thread built in, also planned by startPlannerCtx() while each I/O is in flight for PLAN_BENCH_IO_NS.
+ *			The library prints while reordering, so stdout goes to /dev/null during the runs.
+ *  @param  None
+ *  @return None
+ */
+void benchPlan(void) {
+	uint32_t		*pLatency=malloc(PLAN_BENCH_OPS*sizeof(uint32_t));
+	const char		*modeName[]={ "inline", "planned", "thread" };
+	unsigned		n, mode, i, lba, distance;
+	uint64_t		start, selectNs, planNs, totalDist;
+	reorder_ctx_t	*pCtx;
+	int				savedStdout, devNull;
+
+	assert(NULL!=pLatency);
+	printf("%-10s %8s %10s %10s %10s %10s %10s %14s\n", "mode", "nodes", "mean ns", "p50 ns", "p99 ns", "max ns", "plan ns", "mean distance");
+	for (n=250; n<=PLAN_BENCH_MAX_NODES; n*=4) {
+		for (mode=0; mode<((SELECTED_PLANNER_THREAD==PLANNER_THREAD_POSIX)?3:2); mode++) {
+			fflush(stdout);
+			savedStdout=dup(1);
+			devNull=open("/dev/null", O_WRONLY);
+			assert((savedStdout>=0) && (devNull>=0));
+			dup2(devNull, 1);
+
+			srand(n);
+			pCtx=createReorderCtx(n);
+			setReorderStrategyCtx(pCtx, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+			setPlannerCtx(pCtx, 0!=mode);
+			for (i=0; i<n; i++) {
+				addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+			}
+			if (2==mode) {
+				assert(startPlannerCtx(pCtx, NULL));
+			}
+			selectNs=planNs=totalDist=0;
+			for (i=0; i<PLAN_BENCH_OPS; i++) {
+				if (1==mode) {
+					start=nowNs();
+					(void)planReorderCtx(pCtx, NUMBER_OF_REORDERED);
+					planNs+=nowNs()-start;
+				}
+				start=nowNs();
+				selectTargetLbaCtx(pCtx, &lba, &distance);
+				pLatency[i]=(uint32_t)(nowNs()-start);
+				selectNs+=pLatency[i];
+				totalDist+=distance;
+				if (2==mode) {
+					// The I/O is in flight, and the thread plans meanwhile.
+					while (nowNs()-start<PLAN_BENCH_IO_NS) {
+					}
+				}
+				completeTargetCtx(pCtx, lba);
+				addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+			}
+			destroyReorderCtx(pCtx);
+
+			fflush(stdout);
+			dup2(savedStdout, 1);
+			close(savedStdout);
+			close(devNull);
+			qsort(pLatency, PLAN_BENCH_OPS, sizeof(uint32_t), compareU32);
+			printf("%-10s %8u %10.1f %10u %10u %10u %10.1f %14.2f\n", modeName[mode], n, (double)selectNs/PLAN_BENCH_OPS,
+				pLatency[PLAN_BENCH_OPS/2], pLatency[PLAN_BENCH_OPS*99/100], pLatency[PLAN_BENCH_OPS-1],
+				(double)planNs/PLAN_BENCH_OPS, (double)totalDist/PLAN_BENCH_OPS);
+		}
+	}
+	free(pLatency);
+}
+
+/**
+ *  @brief  Measure placing a new entry in the reordered list of path building at 250 to INSERT_BENCH_MAX_NODES pending segments.
+ *			The list is planned full with planReorderCtx() first, then each completion is followed by a new entry,
+ *			placed by planReorderCtx() before the next selection. Reports the time and the distances taken per placed entry,
+ *			and the mean distance of the selections.
+ *  @param  None
+ *  @return None
+ */
+void benchInsert(void) {
+	unsigned		n, i, lba, distance, placed, entries, plannedDist;
+	uint64_t		start, insertNs, distCalls, totalDist, totalPlanned;
+	reorder_ctx_t	*pCtx;
+	int				savedStdout, devNull;
+
+	printf("%8s %12s %16s %14s %13s\n", "nodes", "ns/insert", "distances/insert", "mean distance", "planned revs");
+	for (n=250; n<=INSERT_BENCH_MAX_NODES; n*=2) {
+		fflush(stdout);
+		savedStdout=dup(1);
+		devNull=open("/dev/null", O_WRONLY);
+		assert((savedStdout>=0) && (devNull>=0));
+		dup2(devNull, 1);
+
+		srand(n);
+		pCtx=createReorderCtx(n);
+		setReorderStrategyCtx(pCtx, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+		setPlannerCtx(pCtx, true);
+		for (i=0; i<n; i++) {
+			addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+		}
+		(void)planReorderCtx(pCtx, NUMBER_OF_REORDERED);
+		insertNs=totalDist=totalPlanned=0;
+		placed=0;
+		distCalls=pCtx->dpReorder.distCalls;
+		for (i=0; i<INSERT_BENCH_OPS; i++) {
+			selectTargetLbaCtx(pCtx, &lba, &distance);
+			totalDist+=distance;
+			completeTargetCtx(pCtx, lba);
+			addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+			start=nowNs();
+			placed+=planReorderCtx(pCtx, NUMBER_OF_REORDERED);
+			insertNs+=nowNs()-start;
+			getPlannedPathCtx(pCtx, &entries, &plannedDist);
+			totalPlanned+=plannedDist;
+		}
+		distCalls=pCtx->dpReorder.distCalls-distCalls;
+		destroyReorderCtx(pCtx);
+
+		fflush(stdout);
+		dup2(savedStdout, 1);
+		close(savedStdout);
+		close(devNull);
+		assert(0!=placed);
+		printf("%8u %12.1f %16.1f %14.2f %13.1f\n", n, (double)insertNs/placed, (double)distCalls/placed, (double)totalDist/INSERT_BENCH_OPS,
+			(double)totalPlanned/INSERT_BENCH_OPS/NUMBER_OF_SG);
+	}
+}
+
+/**
+ *  @brief  SG distance improvePlanCtx() saves on planned path building at 64, 256 and 5000 pending segments, given a budget of time
+ *			after each completion and its new entry are planned, against the path as planned.
+ *			The runs of a queue depth start from the same seed, so they take the same new LBAs bar the rare one already pending.
+ *  @param  None
+ *  @return None
+ */
+void benchImprove(void) {
+	static const unsigned	depth[]={ 64, 256, 5000 };
+	static const uint64_t	budgetNs[IMPROVE_BENCH_BUDGETS]={ 0, 20000, 200000 };
+	unsigned		d, b, i, lba, distance, entries, plannedDist;
+	uint64_t		start, improveNs, totalDist, totalPlanned, saved, baseDist=0;
+	reorder_ctx_t	*pCtx;
+	int				savedStdout, devNull;
+
+	printf("%8s %10s %12s %12s %13s %14s %8s\n", "nodes", "budget ns", "ns/improve", "saved/improve", "planned revs", "mean distance", "gain");
+	for (d=0; d<sizeof(depth)/sizeof(depth[0]); d++) {
+		for (b=0; b<IMPROVE_BENCH_BUDGETS; b++) {
+			fflush(stdout);
+			savedStdout=dup(1);
+			devNull=open("/dev/null", O_WRONLY);
+			assert((savedStdout>=0) && (devNull>=0));
+			dup2(devNull, 1);
+
+			srand(depth[d]);
+			pCtx=createReorderCtx(depth[d]);
+			setReorderStrategyCtx(pCtx, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+			setPlannerCtx(pCtx, true);
+			for (i=0; i<depth[d]; i++) {
+				addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+			}
+			(void)planReorderCtx(pCtx, NUMBER_OF_REORDERED);
+			improveNs=totalDist=totalPlanned=saved=0;
+			for (i=0; i<IMPROVE_BENCH_OPS; i++) {
+				selectTargetLbaCtx(pCtx, &lba, &distance);
+				totalDist+=distance;
+				completeTargetCtx(pCtx, lba);
+				addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+				(void)planReorderCtx(pCtx, NUMBER_OF_REORDERED);
+				if (0!=budgetNs[b]) {
+					start=nowNs();
+					saved+=improvePlanCtx(pCtx, budgetNs[b]);
+					improveNs+=nowNs()-start;
+				}
+				getPlannedPathCtx(pCtx, &entries, &plannedDist);
+				totalPlanned+=plannedDist;
+			}
+			destroyReorderCtx(pCtx);
+
+			fflush(stdout);
+			dup2(savedStdout, 1);
+			close(savedStdout);
+			close(devNull);
+			if (0==b) {
+				baseDist=totalDist;
+			}
+			printf("%8u %10llu %12.1f %13.1f %13.1f %14.2f %7.1f%%\n", depth[d], (unsigned long long)budgetNs[b], (double)improveNs/IMPROVE_BENCH_OPS,
+				(double)saved/IMPROVE_BENCH_OPS, (double)totalPlanned/IMPROVE_BENCH_OPS/NUMBER_OF_SG, (double)totalDist/IMPROVE_BENCH_OPS,
+				100.0*((double)baseDist-(double)totalDist)/(double)baseDist);
+		}
+	}
+}
+
+/**
+ *  @brief  Compare WINDOW_DP with each window, depth and hops of windowBenchConfig against SHORTEST_DIST at 100 to WINDOW_BENCH_MAX_NODES
+ *			pending segments, on the same LBAs. Reports the CPU time and the mean distance of a selection, the I/Os per revolution
+ *			that distance allows, and the gain in I/Os per revolution over shortest distance.
+ *  @param  None
+ *  @return None
+ */
+void benchWindow(void) {
+	unsigned		c, n, i, lba, distance;
+	uint64_t		start, selectNs, totalDist, greedyDist=0;
+	reorder_ctx_t	*pCtx;
+	char			name[64];
+
+	printf("%-24s %8s %12s %14s %10s %8s\n", "strategy", "nodes", "select ns", "mean distance", "I/O/rev", "gain");
+	for (n=100; n<=WINDOW_BENCH_MAX_NODES; n*=10) {
+		for (c=0; c<sizeof(windowBenchConfig)/sizeof(windowBenchConfig[0]); c++) {
+			srand(n);
+			pCtx=createReorderCtx(n);
+			if (0==windowBenchConfig[c][0]) {
+				setReorderStrategyCtx(pCtx, getReorderStrategy(SHORTEST_DIST));
+				snprintf(name, sizeof(name), "%s", pCtx->pStrategy->name);
+			} else {
+				setReorderStrategyCtx(pCtx, getReorderStrategy(WINDOW_DP));
+				assert(setWindowDpCtx(pCtx, windowBenchConfig[c][0], windowBenchConfig[c][1], windowBenchConfig[c][2]));
+				snprintf(name, sizeof(name), "%s %u/%u/%u", pCtx->pStrategy->name, windowBenchConfig[c][0], windowBenchConfig[c][1], windowBenchConfig[c][2]);
+			}
+			for (i=0; i<n; i++) {
+				addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+			}
+			selectNs=totalDist=0;
+			for (i=0; i<WINDOW_BENCH_OPS; i++) {
+				start=nowNs();
+				selectTargetLbaCtx(pCtx, &lba, &distance);
+				selectNs+=nowNs()-start;
+				totalDist+=distance;
+				completeTargetCtx(pCtx, lba);
+				addLbaCtx(pCtx, getNewBenchLba(pCtx), 1);
+			}
+			destroyReorderCtx(pCtx);
+			if (0==c) {
+				greedyDist=totalDist;
+			}
+			printf("%-24s %8u %12.1f %14.2f %10.2f %7.1f%%\n", name, n, (double)selectNs/WINDOW_BENCH_OPS, (double)totalDist/WINDOW_BENCH_OPS,
+				(double)NUMBER_OF_SG*WINDOW_BENCH_OPS/totalDist, 100.0*((double)greedyDist/(double)totalDist-1.0));
+		}
+	}
+}
+
+int main(int argc, char *argv[]) {
+	const char *name=(argc>1)?argv[1]:"all";
+
+	srand(1);
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "distance"))) {
+		printf("Benchmark distance : %u pairs, %u targets per source.\n", DISTANCE_BENCH_PAIRS, DISTANCE_BENCH_BATCH);
+		benchDistance();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "submit"))) {
+		printf("Benchmark submit : 1 to %u producers, %u nodes, %llu ms each.\n", SUBMIT_BENCH_MAX_PRODUCERS, NUM_OF_BENCH_NODES, SUBMIT_BENCH_NS/1000000);
+		benchSubmit();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "batch"))) {
+		printf("Benchmark batch : 1000 to %u nodes added and completed one by one and in a batch.\n", BATCH_BENCH_MAX_NODES);
+		benchBatch();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "tree"))) {
+		printf("Benchmark tree : insert and remove at 1000 to %u pending segments, %u each.\n", TREE_BENCH_MAX_NODES, TREE_BENCH_OPS);
+		benchTree();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "pool"))) {
+		printf("Benchmark pool : create, add up to %u entries and destroy, maxNode 1000 to %u.\n", POOL_BENCH_ADDS, POOL_BENCH_MAX_NODES);
+		benchPool();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "select"))) {
+		printf("Benchmark select : each strategy at 100 to %u pending segments, %u selections each.\n", SELECT_BENCH_MAX_NODES, SELECT_BENCH_OPS);
+		benchSelect();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "budget"))) {
+		printf("Benchmark budget : selection latency with and without a selection budget, %u selections each.\n", BUDGET_BENCH_OPS);
+		benchBudget();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "plan"))) {
+		printf("Benchmark plan : path building filled in the selection and planned ahead, %u selections each.\n", PLAN_BENCH_OPS);
+		benchPlan();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "insert"))) {
+		printf("Benchmark insert : path building placement of a new entry at 250 to %u pending segments, %u each.\n", INSERT_BENCH_MAX_NODES, INSERT_BENCH_OPS);
+		benchInsert();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "improve"))) {
+		printf("Benchmark improve : path building improved with improvePlanCtx() at 64, 256 and 5000 pending segments, %u selections each.\n", IMPROVE_BENCH_OPS);
+		benchImprove();
+	}
+	if ((0==strcmp(name, "all")) || (0==strcmp(name, "window"))) {
+		printf("Benchmark window : window DP against shortest distance at 100 to %u pending segments, %u selections each.\n", WINDOW_BENCH_MAX_NODES, WINDOW_BENCH_OPS);
+		benchWindow();
+	}
+	return 0;
+}
@@ -2,9 +2,11 @@
 #ifdef __linux__
 #include <execinfo.h>
 #include <signal.h>
+#include <pthread.h>
 #endif
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 #include <assert.h>
 #include <stddef.h>
@@ -12,6 +14,52 @@
 #include <sys/time.h>
 #include "../reorderLib.h"
 #define NUM_OF_TEST_NODES	(10000)
+#define DISTANCE_BATCH_TEST_SIZE	(1021)	// Not a multiple of SIMD lanes to test the scalar tail too
+#define CONTEXT_TEST_NODES	(1000)
+#define CONTEXT_TEST_LOOP	(20000)
+#define CONTEXT_TEST_THREADS	(4)
+#define SUBMIT_TEST_PRODUCERS	(4)
+#define SUBMIT_TEST_PER_PRODUCER	(3000)
+#define BATCH_TEST_NODES	(4000)
+#define BATCH_TEST_LOOP		(2000)
+#define TREE_TEST_NODES		(3000)
+#define TREE_TEST_LOOP		(30000)
+#define FINGER_TEST_NODES	(3000)
+#define FINGER_TEST_LOOP	(20000)
+#define FINGER_TEST_ENTRIES	(40)
+#define HANDLE_TEST_NODES	(2000)
+#define HANDLE_TEST_LOOP	(20000)
+#define SLAB_TEST_NODES		(2*SEG_SLAB_SIZE+100)	// A little into the third slab
+#define ADMISSION_TEST_NODES	(2000)
+#define ADMISSION_TEST_HIGH		(1500)
+#define ADMISSION_TEST_LOW		(1000)
+#define STRATEGY_TEST_NODES		(1000)
+#define STRATEGY_TEST_LOOP		(5000)
+#define STRATEGY_TEST_SWITCH	(97)		// Selections between strategy switches
+#define GOVERNOR_TEST_NODES		(2000)
+#define GOVERNOR_TEST_WINDOW	(64)
+#define GOVERNOR_TEST_WINDOWS	(60)
+#define TUNER_TEST_WINDOW		(1024)
+#define TUNER_TEST_WINDOWS		(40)
+#define RANGE_TEST_NODES		(2000)
+#define RANGE_TEST_LOOP			(20000)
+#define LOOKAHEAD_TEST_NODES	(2000)
+#define LOOKAHEAD_TEST_LOOP		(20000)
+#define WINDOW_TEST_SETS		(30)		// Sets of entries, each drained in the order of a single window
+#define WINDOW_TEST_SET_SIZE	(7)
+#define WINDOW_TEST_NODES		(300)
+#define WINDOW_TEST_LOOP		(3000)
+#define BUDGET_TEST_NODES		(500)
+#define BUDGET_TEST_LOOP		(1000)
+#define PLANNER_TEST_NODES		(300)
+#define PLANNER_TEST_LOOP		(2000)
+#define LINK_TEST_NODES			(500)
+#define LINK_TEST_LOOP			(3000)
+#define LINK_TEST_SWITCH		(1000)		// Selections between strategy switches
+#define IMPROVE_TEST_NODES		(300)
+#define IMPROVE_TEST_LOOP		(2000)
+#define IMPROVE_TEST_NS			(2000)		// Budget of most improvements, too short for a whole pass
+#define IMPROVE_TEST_SLACK_NS	(10000)		// Overrun of the budget allowed, for the last SG looked through and the last move
 #define TEST_LOOP			(1000000-NUM_OF_TEST_NODES)     // Default 1000000 total.
 #undef  PERF_LOGGING        // Change to define to allow performance logging
 
@@ -38,12 +86,1661 @@ void handler(int sig) {
 #endif // __x86_64__, __amd64__, __ARM_ARCH
 #endif // PERF_LOGGING
 
+/**
+ *  @brief  Reference distance, probing pInvSeekProfile[] one revolution at a time
+ *  @param  reorder_ctx_t *pCtx - context, unsigned startSg - starting SG, unsigned startTrack- starting track, 
+ *			unsigned targetSg - target SG, unsigned targetTrack- target track
+ *  @return the distance
+ */
+unsigned getDistanceByProbing(reorder_ctx_t *pCtx, unsigned startSg, unsigned startTrack, unsigned targetSg, unsigned targetTrack) {
+	unsigned 	sgDiff, track_diff, track_range_top, track_range_bottom;
+
+	while (startSg >= targetSg) {
+		targetSg+=NUMBER_OF_SG;
+	}
+	sgDiff=targetSg-startSg;
+	while (true) {
+		track_diff=pCtx->pInvSeekProfile[sgDiff];
+		track_range_top=startTrack+track_diff;
+		track_range_top=MIN(track_range_top, NUMBER_OF_TRACKS-1);
+		track_range_bottom=(startTrack>=track_diff)?startTrack-track_diff:0;
+		if ((targetTrack<=track_range_top) && (targetTrack>=track_range_bottom)) {
+			break;
+		}
+		sgDiff+=NUMBER_OF_SG;
+		assert(sgDiff<SEEK_TIME_LIMIT);
+	}
+	return sgDiff;
+}
+
+/**
+ *  @brief  Compare getDistanceCtx() and getDistanceFast() against getDistanceByProbing() for every (sgDiff, trackDiff) pair,
+ *			seeking both outward and inward.
+ *  @param  reorder_ctx_t *pCtx - context
+ *  @return None
+ */
+void checkDistance(reorder_ctx_t *pCtx) {
+	unsigned sgDiff, trackDiff, startSg, targetSg, expected, dist;
+
+	for (sgDiff=1; sgDiff<=NUMBER_OF_SG; sgDiff++) {
+		startSg=(sgDiff*7)%NUMBER_OF_SG;
+		targetSg=(startSg+sgDiff)%NUMBER_OF_SG;
+		for (trackDiff=0; trackDiff<NUMBER_OF_TRACKS; trackDiff++) {
+			expected=getDistanceByProbing(pCtx, startSg, 0, targetSg, trackDiff);
+			getDistanceCtx(pCtx, startSg, 0, targetSg, trackDiff, &dist);
+			assert(dist==expected);
+			assert(getDistanceFast(pCtx, startSg, 0, targetSg, trackDiff)==expected);
+
+			expected=getDistanceByProbing(pCtx, startSg, NUMBER_OF_TRACKS-1, targetSg, NUMBER_OF_TRACKS-1-trackDiff);
+			getDistanceCtx(pCtx, startSg, NUMBER_OF_TRACKS-1, targetSg, NUMBER_OF_TRACKS-1-trackDiff, &dist);
+			assert(dist==expected);
+			assert(getDistanceFast(pCtx, startSg, NUMBER_OF_TRACKS-1, targetSg, NUMBER_OF_TRACKS-1-trackDiff)==expected);
+		}
+	}
+}
+
+/**
+ *  @brief  Compare getDistanceBatchCtx() and all implementations the CPU supports against getDistanceCtx() with random pairs.
+ *			Uses its own pseudo random sequence not to change the sequence of rand() for the main test.
+ *  @param  reorder_ctx_t *pCtx - context
+ *  @return None
+ */
+void checkDistanceBatch(reorder_ctx_t *pCtx) {
+	uint16_t	sg[DISTANCE_BATCH_TEST_SIZE], track[DISTANCE_BATCH_TEST_SIZE];
+	unsigned	out[DISTANCE_BATCH_TEST_SIZE], outSse4[DISTANCE_BATCH_TEST_SIZE], outAvx2[DISTANCE_BATCH_TEST_SIZE];
+	unsigned	i, j, dist, srcSg, srcTrack;
+	uint32_t	x=2463534242u;
+	const char	*impl=getDistanceBatchImpl();
+	bool		sse4=(0==strcmp(impl, "sse4")) || (0==strcmp(impl, "avx2"));
+	bool		avx2=(0==strcmp(impl, "avx2"));
+
+	printf("Checking getDistanceBatch() with %s implementation.\n", impl);
+	for (j=0; j<100; j++) {
+		x^=x<<13; x^=x>>17; x^=x<<5;
+		srcSg=x%NUMBER_OF_SG;
+		srcTrack=(x>>9)%NUMBER_OF_TRACKS;
+		for (i=0; i<DISTANCE_BATCH_TEST_SIZE; i++) {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			sg[i]=x%NUMBER_OF_SG;
+			track[i]=(x>>9)%NUMBER_OF_TRACKS;
+		}
+		getDistanceBatchCtx(pCtx, srcSg, srcTrack, sg, track, DISTANCE_BATCH_TEST_SIZE, out);
+		if (sse4) {
+			getDistanceBatchSse4(pCtx, srcSg, srcTrack, sg, track, DISTANCE_BATCH_TEST_SIZE, outSse4);
+		}
+		if (avx2) {
+			getDistanceBatchAvx2(pCtx, srcSg, srcTrack, sg, track, DISTANCE_BATCH_TEST_SIZE, outAvx2);
+		}
+		for (i=0; i<DISTANCE_BATCH_TEST_SIZE; i++) {
+			getDistanceCtx(pCtx, srcSg, srcTrack, sg[i], track[i], &dist);
+			assert(out[i]==dist);
+			assert((!sse4) || (outSse4[i]==dist));
+			assert((!avx2) || (outAvx2[i]==dist));
+		}
+	}
+}
+
+typedef struct contextTest {
+	reorder_ctx_t	*pCtx;
+	bool			useGlobalApi;	// Go through the functions without a context, pCtx being the default context
+	unsigned		totalDist;
+} contextTest_t;
+
+/**
+ *  @brief  Run a short add/select/complete workload on one context with a fixed pseudo random sequence.
+ *  @param  void *arg - contextTest_t of the context. The total distance is written back to it.
+ *  @return NULL
+ */
+void *runContextWorkload(void *arg) {
+	contextTest_t	*pTest=(contextTest_t *)arg;
+	reorder_ctx_t	*pCtx=pTest->pCtx;
+	uint32_t		x=88172645u;
+	unsigned		i, lba, targetLba, dist;
+
+	pTest->totalDist=0;
+	for (i=0; i<CONTEXT_TEST_NODES+CONTEXT_TEST_LOOP; i++) {
+		// Prime with CONTEXT_TEST_NODES nodes, then complete one and add one
+		if (i>=CONTEXT_TEST_NODES) {
+			if (pTest->useGlobalApi) {
+				selectTargetLba(&targetLba, &dist);
+				completeTarget(targetLba);
+			} else {
+				selectTargetLbaCtx(pCtx, &targetLba, &dist);
+				completeTargetCtx(pCtx, targetLba);
+			}
+			pTest->totalDist+=dist;
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (NULL_SEG_IDX!=searchAvl(&pCtx->cacheMgmt.tavl, lba));
+		if (pTest->useGlobalApi) {
+			addLba(lba, 1);
+		} else {
+			addLbaCtx(pCtx, lba, 1);
+		}
+	}
+	return NULL;
+}
+
+/**
+ *  @brief  Run the same workload on the default context and on CONTEXT_TEST_THREADS contexts at the same time, each from its own thread.
+ *			All of them must end up with the same total distance as contexts do not share any state.
+ *  @param  None
+ *  @return None
+ */
+void checkContexts(void) {
+	contextTest_t	test[CONTEXT_TEST_THREADS+1];
+#ifdef __linux__
+	pthread_t		thread[CONTEXT_TEST_THREADS];
+	int				ret;
+#endif
+	unsigned		i;
+
+	printf("Checking %u contexts driven from their own threads against the default context.\n", CONTEXT_TEST_THREADS);
+	initCache(CONTEXT_TEST_NODES);
+	test[0].pCtx=getDefaultReorderCtx();
+	test[0].useGlobalApi=true;
+	(void)runContextWorkload(&test[0]);
+
+	for (i=1; i<=CONTEXT_TEST_THREADS; i++) {
+		test[i].pCtx=createReorderCtx(CONTEXT_TEST_NODES);
+		test[i].useGlobalApi=false;
+	}
+#ifdef __linux__
+	for (i=1; i<=CONTEXT_TEST_THREADS; i++) {
+		ret=pthread_create(&thread[i-1], NULL, runContextWorkload, &test[i]);
+		assert(0==ret);
+	}
+	for (i=1; i<=CONTEXT_TEST_THREADS; i++) {
+		ret=pthread_join(thread[i-1], NULL);
+		assert(0==ret);
+	}
+#else
+	for (i=1; i<=CONTEXT_TEST_THREADS; i++) {
+		(void)runContextWorkload(&test[i]);
+	}
+#endif
+	for (i=1; i<=CONTEXT_TEST_THREADS; i++) {
+		assert(test[i].totalDist==test[0].totalDist);
+		destroyReorderCtx(test[i].pCtx);
+	}
+	printf("All contexts completed with total distance:%u.\n", test[0].totalDist);
+}
+
+typedef struct submitTest {
+	reorder_ctx_t	*pCtx;
+	unsigned		producer;
+} submitTest_t;
+
+/**
+ *  @brief  LBA of the given submission of the given producer. Unique over all producers.
+ *			Producer SUBMIT_TEST_PRODUCERS is the test itself filling up the ring.
+ *  @param  unsigned producer - producer index, unsigned i - submission index of the producer
+ *  @return LBA
+ */
+unsigned getSubmitTestLba(unsigned producer, unsigned i) {
+	return (i*(SUBMIT_TEST_PRODUCERS+1)+producer)*(NUMBER_OF_BLOCKS/((SUBMIT_TEST_PRODUCERS+1)*MAX(SUBMIT_TEST_PER_PRODUCER, SUBMIT_RING_SIZE)));
+}
+
+/**
+ *  @brief  Producer of checkSubmitRing(). Submits SUBMIT_TEST_PER_PRODUCER entries, retrying while the ring is full.
+ *  @param  void *arg - submitTest_t of the producer
+ *  @return NULL
+ */
+void *runSubmitProducer(void *arg) {
+	submitTest_t	*pTest=(submitTest_t *)arg;
+	unsigned		i, lba;
+
+	for (i=0; i<SUBMIT_TEST_PER_PRODUCER; i++) {
+		lba=getSubmitTestLba(pTest->producer, i);
+		while (!submitLbaCtx(pTest->pCtx, lba, 1, (uint64_t)lba<<8|pTest->producer)) {
+		}
+	}
+	return NULL;
+}
+
+/**
+ *  @brief  Check the submission ring. Fill it up until it rejects, then let SUBMIT_TEST_PRODUCERS threads submit
+ *			while this thread drains, and check that every entry got added once with its tag.
+ *  @param  None
+ *  @return None
+ */
+void checkSubmitRing(void) {
+	unsigned		total=SUBMIT_TEST_PRODUCERS*SUBMIT_TEST_PER_PRODUCER+SUBMIT_RING_SIZE;
+	reorder_ctx_t	*pCtx=createReorderCtx(total);
+	submitTest_t	test[SUBMIT_TEST_PRODUCERS];
+#ifdef __linux__
+	pthread_t		thread[SUBMIT_TEST_PRODUCERS];
+	int				ret;
+#endif
+	unsigned		i, j, lba, drained;
+	segIdx_t		cNode;
+
+	printf("Checking the submission ring with %u producers.\n", SUBMIT_TEST_PRODUCERS);
+	// Use the LBAs of a producer that does not exist to fill the ring
+	for (i=0; i<SUBMIT_RING_SIZE; i++) {
+		assert(submitLbaCtx(pCtx, getSubmitTestLba(SUBMIT_TEST_PRODUCERS, i), 1, i));
+	}
+	assert(!submitLbaCtx(pCtx, 1, 1, 0));
+	assert(SUBMIT_RING_SIZE==drainSubmissionsCtx(pCtx));
+	assert(0==drainSubmissionsCtx(pCtx));
+
+	for (i=0; i<SUBMIT_TEST_PRODUCERS; i++) {
+		test[i].pCtx=pCtx;
+		test[i].producer=i;
+	}
+#ifdef __linux__
+	for (i=0; i<SUBMIT_TEST_PRODUCERS; i++) {
+		ret=pthread_create(&thread[i], NULL, runSubmitProducer, &test[i]);
+		assert(0==ret);
+	}
+	drained=SUBMIT_RING_SIZE;
+	while (drained<total) {
+		drained+=drainSubmissionsCtx(pCtx);
+	}
+	for (i=0; i<SUBMIT_TEST_PRODUCERS; i++) {
+		ret=pthread_join(thread[i], NULL);
+		assert(0==ret);
+	}
+#else
+	// Without threads, the ring needs to be drained before it gets full
+	for (j=0; j<SUBMIT_TEST_PER_PRODUCER; j++) {
+		for (i=0; i<SUBMIT_TEST_PRODUCERS; i++) {
+			lba=getSubmitTestLba(i, j);
+			assert(submitLbaCtx(pCtx, lba, 1, (uint64_t)lba<<8|i));
+		}
+		(void)drainSubmissionsCtx(pCtx);
+	}
+#endif
+	assert(0==drainSubmissionsCtx(pCtx));
+	assert(total==(unsigned)pCtx->cacheMgmt.tavl.active_nodes);
+	for (i=0; i<SUBMIT_TEST_PRODUCERS; i++) {
+		for (j=0; j<SUBMIT_TEST_PER_PRODUCER; j++) {
+			lba=getSubmitTestLba(i, j);
+			cNode=searchAvl(&pCtx->cacheMgmt.tavl, lba);
+			assert(NULL_SEG_IDX!=cNode);
+			assert(pCtx->pTagPool[cNode]==((uint64_t)lba<<8|i));
+		}
+	}
+	destroyReorderCtx(pCtx);
+}
+
+/**
+ *  @brief  Check that both contexts hold the same LBAs, in the master thread and in every SG container, with balanced trees.
+ *  @param  reorder_ctx_t *pA - context, reorder_ctx_t *pB - context to compare with
+ *  @return None
+ */
+void checkSameNodes(reorder_ctx_t *pA, reorder_ctx_t *pB) {
+	segIdx_t	aNode, bNode;
+	unsigned	sg;
+#if (SELECTED_SG_CONTAINER==SG_CONTAINER_ARRAY)
+	unsigned	i;
+#endif
+
+	assert(pA->cacheMgmt.tavl.active_nodes==pB->cacheMgmt.tavl.active_nodes);
+	assert(tavlHeightCheck(&pA->cacheMgmt.tavl, pA->cacheMgmt.tavl.root));
+	assert(tavlHeightCheck(&pB->cacheMgmt.tavl, pB->cacheMgmt.tavl.root));
+	aNode=tavlLink(&pA->cacheMgmt.tavl, pA->cacheMgmt.tavl.lowest)->higher;
+	bNode=tavlLink(&pB->cacheMgmt.tavl, pB->cacheMgmt.tavl.lowest)->higher;
+	while (aNode!=pA->cacheMgmt.tavl.highest) {
+		assert(bNode!=pB->cacheMgmt.tavl.highest);
+		assert(pA->pSegmentPool[aNode].key==pB->pSegmentPool[bNode].key);
+		assert(searchAvl(&pB->cacheMgmt.tavl, pA->pSegmentPool[aNode].key)==bNode);
+		aNode=tavlLink(&pA->cacheMgmt.tavl, aNode)->higher;
+		bNode=tavlLink(&pB->cacheMgmt.tavl, bNode)->higher;
+	}
+	assert(bNode==pB->cacheMgmt.tavl.highest);
+	for (sg=0; sg<NUMBER_OF_SG; sg++) {
+#if (SELECTED_SG_CONTAINER==SG_CONTAINER_ARRAY)
+		assert(pA->pSgArray[sg].count==pB->pSgArray[sg].count);
+		for (i=0; i<pB->pSgArray[sg].count; i++) {
+			assert(pA->pSgArray[sg].pEntry[i].key==pB->pSgArray[sg].pEntry[i].key);
+			assert(pA->pSgArray[sg].pEntry[i].track==pB->pSgArray[sg].pEntry[i].track);
+			assert(pB->pSegmentPool[pB->pSgArray[sg].pEntry[i].segIdx].key==pB->pSgArray[sg].pEntry[i].key);
+		}
+#else
+		assert(pA->pSgTavl[sg].active_nodes==pB->pSgTavl[sg].active_nodes);
+		assert(tavlHeightCheck(&pB->pSgTavl[sg], pB->pSgTavl[sg].root));
+		aNode=tavlLink(&pA->pSgTavl[sg], pA->pSgTavl[sg].lowest)->higher;
+		bNode=tavlLink(&pB->pSgTavl[sg], pB->pSgTavl[sg].lowest)->higher;
+		while (aNode!=pA->pSgTavl[sg].highest) {
+			assert(pA->pSegmentPool[aNode].key==pB->pSegmentPool[bNode].key);
+			assert(searchAvl(&pB->pSgTavl[sg], pA->pSegmentPool[aNode].key)==bNode);
+			aNode=tavlLink(&pA->pSgTavl[sg], aNode)->higher;
+			bNode=tavlLink(&pB->pSgTavl[sg], bNode)->higher;
+		}
+		assert(bNode==pB->pSgTavl[sg].highest);
+#endif
+	}
+	assert(0==memcmp(&pA->sgBitmap, &pB->sgBitmap, sizeof(sgBitmap_t)));
+}
+
+/**
+ *  @brief  Height of a perfectly balanced tree with the given number of nodes.
+ *  @param  unsigned n - number of nodes
+ *  @return height
+ */
+unsigned getBalancedHeight(unsigned n) {
+	unsigned	height;
+
+	for (height=0; n>0; n>>=1) {
+		height++;
+	}
+	return height;
+}
+
+/**
+ *  @brief  Check addLbaBatchCtx() and completeTargetBatchCtx() against the same entries added and completed one by one.
+ *			Covers an unsorted batch into an empty tree, one merged into a tree and one small enough to go one by one,
+ *			batched completions followed by the same selections, and a sorted batch.
+ *  @param  None
+ *  @return None
+ */
+void checkBatch(void) {
+	reorder_ctx_t	*pA=createReorderCtx(BATCH_TEST_NODES);
+	reorder_ctx_t	*pB=createReorderCtx(BATCH_TEST_NODES);
+	reorder_ctx_t	*pC=createReorderCtx(BATCH_TEST_NODES);
+	unsigned		*lbas=malloc(BATCH_TEST_NODES*sizeof(unsigned));
+	unsigned		*blocks=malloc(BATCH_TEST_NODES*sizeof(unsigned));
+	unsigned		i, n, count, lbaA, lbaB, distA, distB;
+	uint32_t		x=2463534242u;
+	segIdx_t		cNode;
+
+	assert((NULL!=lbas) && (NULL!=blocks));
+	printf("Checking batched add and complete against one by one.\n");
+	// 3/4 into an empty tree, then merged into the tree, then 8 nodes that go one by one.
+	for (n=0; n<BATCH_TEST_NODES; n+=count) {
+		count=(0==n)?BATCH_TEST_NODES*3/4:(n<BATCH_TEST_NODES-8)?BATCH_TEST_NODES-8-n:8;
+		for (i=0; i<count; i++) {
+			do {
+				x^=x<<13; x^=x>>17; x^=x<<5;
+				lbas[i]=x%NUMBER_OF_BLOCKS;
+			} while (NULL_SEG_IDX!=searchAvl(&pA->cacheMgmt.tavl, lbas[i]));
+			blocks[i]=1+(x&7);
+			addLbaCtx(pA, lbas[i], blocks[i]);
+			addLbaCtx(pC, lbas[i], blocks[i]);
+		}
+		addLbaBatchCtx(pB, lbas, blocks, count);
+		if (0==n) {
+			assert(avlHeight(&pB->cacheMgmt.tavl, pB->cacheMgmt.tavl.root)==getBalancedHeight(count));
+		}
+		checkSameNodes(pA, pB);
+	}
+
+	// Complete the targets pA selects one by one on pC, which has not selected anything either, and in one batch on pB.
+	for (i=0; i<BATCH_TEST_LOOP; i++) {
+		selectTargetLbaCtx(pA, &lbas[i], &distA);
+		completeTargetCtx(pA, lbas[i]);
+		completeTargetCtx(pC, lbas[i]);
+	}
+	completeTargetBatchCtx(pB, lbas, BATCH_TEST_LOOP);
+	assert(avlHeight(&pB->cacheMgmt.tavl, pB->cacheMgmt.tavl.root)==getBalancedHeight(BATCH_TEST_NODES-BATCH_TEST_LOOP));
+	checkSameNodes(pC, pB);
+	assert(pC->cacheMgmt.currentLba==pB->cacheMgmt.currentLba);
+	assert(pC->pSegmentPool[pC->cacheMgmt.higherNode].key==pB->pSegmentPool[pB->cacheMgmt.higherNode].key);
+	// From there, both must select the same targets, with 4 targets in the middle completed in a batch too small for the tree.
+	for (i=0; i<BATCH_TEST_NODES-BATCH_TEST_LOOP; i++) {
+		selectTargetLbaCtx(pC, &lbaA, &distA);
+		completeTargetCtx(pC, lbaA);
+		if ((i>=BATCH_TEST_LOOP/2) && (i<BATCH_TEST_LOOP/2+4)) {
+			lbas[i-BATCH_TEST_LOOP/2]=lbaA;
+			if (i==BATCH_TEST_LOOP/2+3) {
+				completeTargetBatchCtx(pB, lbas, 4);
+				checkSameNodes(pC, pB);
+			}
+			continue;
+		}
+		selectTargetLbaCtx(pB, &lbaB, &distB);
+		assert((lbaA==lbaB) && (distA==distB));
+		completeTargetCtx(pB, lbaB);
+	}
+	assert(0==pB->cacheMgmt.tavl.active_nodes);
+	destroyReorderCtx(pB);
+	destroyReorderCtx(pC);
+
+	// Sorted input, the nodes left in pA in LBA order.
+	pB=createReorderCtx(BATCH_TEST_NODES);
+	for (n=0, cNode=tavlLink(&pA->cacheMgmt.tavl, pA->cacheMgmt.tavl.lowest)->higher; cNode!=pA->cacheMgmt.tavl.highest; cNode=tavlLink(&pA->cacheMgmt.tavl, cNode)->higher, n++) {
+		lbas[n]=pA->pSegmentPool[cNode].key;
+		blocks[n]=pA->pSegmentPool[cNode].numberOfBlocks;
+	}
+	addLbaBatchCtx(pB, lbas, blocks, n);
+	assert(avlHeight(&pB->cacheMgmt.tavl, pB->cacheMgmt.tavl.root)==getBalancedHeight(n));
+	checkSameNodes(pA, pB);
+
+	destroyReorderCtx(pA);
+	destroyReorderCtx(pB);
+	free(lbas);
+	free(blocks);
+}
+
+/**
+ *  @brief  Check that both trees stay balanced, with consistent parent links and heights, under random insertions and removals,
+ *			and that the LBA hash finds exactly the pending entries.
+ *  @param  None
+ *  @return None
+ */
+void checkTreeOps(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(TREE_TEST_NODES);
+	reorder_handle_t	handle[TREE_TEST_NODES], found;
+	unsigned			i, j, count, lba, sg;
+	uint32_t			x=2463534242u;
+
+	printf("Checking tree insertions and removals.\n");
+	for (i=0, count=0; i<TREE_TEST_LOOP; i++) {
+		x^=x<<13; x^=x>>17; x^=x<<5;
+		// Grow to the pool size, then keep removing and adding at random
+		if ((count==TREE_TEST_NODES) || ((count>0) && (i>TREE_TEST_NODES) && (x&1))) {
+			j=(x>>1)%count;
+			lba=getHandleLbaCtx(pCtx, handle[j]);
+			freeNode(pCtx, &pCtx->pSegmentPool[handle[j]]);
+			assert(!getLbaHandleCtx(pCtx, lba, &found));
+			handle[j]=handle[--count];
+		} else {
+			do {
+				x^=x<<13; x^=x>>17; x^=x<<5;
+				lba=x%NUMBER_OF_BLOCKS;
+			} while (NULL_SEG_IDX!=searchAvl(&pCtx->cacheMgmt.tavl, lba));
+			handle[count++]=addLbaCtx(pCtx, lba, 1);
+		}
+		if (0==(i%1000)) {
+			assert(tavlHeightCheck(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.root));
+			assert((NULL_SEG_IDX==pCtx->cacheMgmt.tavl.root) || (NULL_SEG_IDX==tavlLink(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.root)->parent));
+#if (SELECTED_SG_CONTAINER==SG_CONTAINER_TAVL)
+			for (sg=0; sg<NUMBER_OF_SG; sg++) {
+				assert(tavlHeightCheck(&pCtx->pSgTavl[sg], pCtx->pSgTavl[sg].root));
+			}
+#endif
+		}
+	}
+	assert(count==(unsigned)pCtx->cacheMgmt.tavl.active_nodes);
+	for (j=0; j<count; j++) {
+		assert(searchAvl(&pCtx->cacheMgmt.tavl, getHandleLbaCtx(pCtx, handle[j]))==handle[j]);
+		assert(getLbaHandleCtx(pCtx, getHandleLbaCtx(pCtx, handle[j]), &found) && (found==handle[j]));
+	}
+	destroyReorderCtx(pCtx);
+}
+
+/**
+ *  @brief  Check searchTavlFrom() from random nodes against searchTavl() in the master tree and the SG trees while adding, removing and selecting,
+ *			that the finger of every SG stays on a pending node of the SG, and lowerBoundSgArrayFrom() from every index against a linear search.
+ *  @param  None
+ *  @return None
+ */
+void checkFingerSearch(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(FINGER_TEST_NODES);
+	reorder_handle_t	handle[FINGER_TEST_NODES];
+	sgEntry_t			entry[FINGER_TEST_ENTRIES];
+	sgArray_t			array={ entry, 0, FINGER_TEST_ENTRIES, 0 };
+	unsigned			i, j, count, lba, distance, hint, key, expected;
+	uint64_t			visits=0;
+	uint32_t			x=362436069u;
+#if (SELECTED_SG_CONTAINER==SG_CONTAINER_TAVL)
+	tavl_t				*pTavl;
+	unsigned			sg;
+#endif
+
+	printf("Checking searches from a finger against searches from the root.\n");
+	// Fingers only move with selections of shortest distance, which keeps no state on the entries freed here.
+	setReorderStrategyCtx(pCtx, getReorderStrategy(SHORTEST_DIST));
+	for (i=0, count=0; i<FINGER_TEST_LOOP; i++) {
+		x^=x<<13; x^=x>>17; x^=x<<5;
+		if ((count==FINGER_TEST_NODES) || ((count>0) && (i>FINGER_TEST_NODES) && (x&1))) {
+			j=(x>>1)%count;
+			freeNode(pCtx, &pCtx->pSegmentPool[handle[j]]);
+			handle[j]=handle[--count];
+		} else {
+			do {
+				x^=x<<13; x^=x>>17; x^=x<<5;
+				lba=x%NUMBER_OF_BLOCKS;
+			} while (NULL_SEG_IDX!=searchAvl(&pCtx->cacheMgmt.tavl, lba));
+			handle[count++]=addLbaCtx(pCtx, lba, 1);
+		}
+		if (0==count) {
+			continue;
+		}
+		(void)selectTargetFromCurrentCtx(pCtx, &distance);
+		x^=x<<13; x^=x>>17; x^=x<<5;
+		j=x%count;
+		lba=getHandleLbaCtx(pCtx, handle[(j+1)%count])+(x>>30)-1;
+		assert(searchTavlFrom(&pCtx->cacheMgmt.tavl, handle[j], lba, &visits)==searchTavl(&pCtx->cacheMgmt.tavl, lba));
+		lba=x%NUMBER_OF_BLOCKS;
+		assert(searchTavlFrom(&pCtx->cacheMgmt.tavl, handle[j], lba, &visits)==searchTavl(&pCtx->cacheMgmt.tavl, lba));
+#if (SELECTED_SG_CONTAINER==SG_CONTAINER_TAVL)
+		pTavl=&pCtx->pSgTavl[pCtx->pSegmentPool[handle[j]].sg];
+		assert(searchTavlFrom(pTavl, handle[j], lba, &visits)==searchTavl(pTavl, lba));
+		for (sg=0; sg<NUMBER_OF_SG; sg++) {
+			pTavl=&pCtx->pSgTavl[sg];
+			assert((NULL_SEG_IDX==pTavl->finger) || (searchAvl(pTavl, pCtx->pSegmentPool[pTavl->finger].key)==pTavl->finger));
+		}
+#endif
+	}
+	assert(0!=visits);
+	destroyReorderCtx(pCtx);
+
+	// Keys 1, 4, 7, ... so that every key falls on, between, below and above the entries
+	for (array.count=0; array.count<=FINGER_TEST_ENTRIES; array.count++) {
+		if (array.count>0) {
+			entry[array.count-1].key=3*(array.count-1)+1;
+		}
+		for (hint=0; hint<=array.count+1; hint++) {
+			for (key=0; key<=3*array.count+2; key++) {
+				for (expected=0; (expected<array.count) && (entry[expected].key<key); expected++);
+				assert(lowerBoundSgArrayFrom(&array, hint, key, &visits)==expected);
+			}
+		}
+	}
+}
+
+/**
+ *  @brief  Check selectTargetHandleCtx() and completeHandleCtx() against selectTargetLbaCtx() and completeTargetCtx()
+ *			on the same workload. Every tag must come back with its entry.
+ *  @param  None
+ *  @return None
+ */
+void checkHandles(void) {
+	reorder_ctx_t		*pA=createReorderCtx(HANDLE_TEST_NODES);
+	reorder_ctx_t		*pB=createReorderCtx(HANDLE_TEST_NODES);
+	reorder_handle_t	handle;
+	uint64_t			tag;
+	unsigned			i, lba, lbaA, distA, distB;
+	uint32_t			x=88172645u;
+
+	printf("Checking handle based completion against LBA based completion.\n");
+	for (i=0; i<HANDLE_TEST_NODES+HANDLE_TEST_LOOP; i++) {
+		if (i>=HANDLE_TEST_NODES) {
+			selectTargetLbaCtx(pA, &lbaA, &distA);
+			completeTargetCtx(pA, lbaA);
+			selectTargetHandleCtx(pB, &handle, &tag, &distB);
+			assert(getHandleLbaCtx(pB, handle)==lbaA);
+			assert(distA==distB);
+			assert(tag==((uint64_t)lbaA<<16|(lbaA&0xffff)));
+			completeHandleCtx(pB, handle);
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (NULL_SEG_IDX!=searchAvl(&pA->cacheMgmt.tavl, lba));
+		(void)addLbaCtx(pA, lba, 1);
+		handle=addLbaTaggedCtx(pB, lba, 1, (uint64_t)lba<<16|(lba&0xffff));
+		assert((handle>=FIRST_SEG_IDX) && (handle<FIRST_SEG_IDX+HANDLE_TEST_NODES));
+		assert(getHandleLbaCtx(pB, handle)==lba);
+	}
+	checkSameNodes(pA, pB);
+	destroyReorderCtx(pA);
+	destroyReorderCtx(pB);
+}
+
+/**
+ *  @brief  Check that the segment pool commits slabs as it grows, refuses entries past maxNode without losing any,
+ *			and gives back the slabs above the highest pending entry when shrunk.
+ *  @param  None
+ *  @return None
+ */
+void checkSlabPool(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(SLAB_TEST_NODES);
+	reorder_handle_t	handle;
+	uint64_t			tag;
+	unsigned			*lbas;
+	unsigned			i, stride, half, pending, dist;
+
+	printf("Checking the segment pool grows a slab at a time, refuses entries when full and shrinks back.\n");
+	lbas=malloc((SLAB_TEST_NODES+10)*sizeof(unsigned));
+	assert(NULL!=lbas);
+	stride=NUMBER_OF_BLOCKS/(SLAB_TEST_NODES+11);
+	for (i=0; i<SLAB_TEST_NODES+10; i++) {
+		lbas[i]=i*stride;
+	}
+	// Only the first slab, holding the reserved segments, is committed at first.
+	assert((1==pCtx->cacheMgmt.committedSlabs) && (0==pCtx->cacheMgmt.topNode));
+
+	// Untouched segments are handed out in order, one by one and in a batch that does not fit.
+	half=SLAB_TEST_NODES/2;
+	for (i=0; i<half; i++) {
+		handle=addLbaCtx(pCtx, lbas[i], 1);
+		assert(FIRST_SEG_IDX+i==handle);
+	}
+	assert(SLAB_TEST_NODES-half==addLbaBatchCtx(pCtx, &lbas[half], NULL, SLAB_TEST_NODES+10-half));
+	assert((3==pCtx->cacheMgmt.committedSlabs) && (SLAB_TEST_NODES==pCtx->cacheMgmt.topNode));
+	assert(SLAB_TEST_NODES==pCtx->cacheMgmt.tavl.active_nodes);
+	assert(tavlHeightCheck(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.root));
+
+	// Full. Adding fails without changing anything, and a submission stays queued.
+	assert(REORDER_INVALID_HANDLE==addLbaCtx(pCtx, lbas[SLAB_TEST_NODES], 1));
+	assert(!getLbaHandleCtx(pCtx, lbas[SLAB_TEST_NODES], &handle));
+	assert(submitLbaCtx(pCtx, lbas[SLAB_TEST_NODES+1], 1, 0x5ab));
+	assert(0==drainSubmissionsCtx(pCtx));
+	assert(SLAB_TEST_NODES==pCtx->cacheMgmt.tavl.active_nodes);
+
+	// Complete everything above the first slab, then shrink back to it.
+	for (i=SEG_SLAB_SIZE-FIRST_SEG_IDX; i<SLAB_TEST_NODES; i++) {
+		completeHandleCtx(pCtx, FIRST_SEG_IDX+i);
+	}
+	assert(2==shrinkPoolCtx(pCtx));
+	assert((1==pCtx->cacheMgmt.committedSlabs) && (SEG_SLAB_SIZE-FIRST_SEG_IDX==pCtx->cacheMgmt.topNode));
+	assert(0==shrinkPoolCtx(pCtx));
+
+	// The queued submission gets the first segment of the second slab, committed again.
+	assert(1==drainSubmissionsCtx(pCtx));
+	assert(getLbaHandleCtx(pCtx, lbas[SLAB_TEST_NODES+1], &handle) && (SEG_SLAB_SIZE==handle));
+	assert(2==pCtx->cacheMgmt.committedSlabs);
+	pending=SEG_SLAB_SIZE-FIRST_SEG_IDX+1;
+	assert(pending==(unsigned)pCtx->cacheMgmt.tavl.active_nodes);
+	assert(tavlHeightCheck(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.root));
+	for (i=0; i<SEG_SLAB_SIZE-FIRST_SEG_IDX; i++) {
+		assert(getLbaHandleCtx(pCtx, lbas[i], &handle) && (FIRST_SEG_IDX+i==handle));
+	}
+
+	// Select and complete the rest, then the second slab can go again.
+	while (pending>0) {
+		selectTargetHandleCtx(pCtx, &handle, &tag, &dist);
+		assert(getLbaHandleCtx(pCtx, getHandleLbaCtx(pCtx, handle), &handle));
+		assert(((SEG_SLAB_SIZE==handle)?0x5ab:0)==tag);
+		completeHandleCtx(pCtx, handle);
+		pending--;
+	}
+	assert(0==pCtx->cacheMgmt.tavl.active_nodes);
+	assert(1==shrinkPoolCtx(pCtx));
+	assert((1==pCtx->cacheMgmt.committedSlabs) && (0==pCtx->cacheMgmt.topNode));
+	free(lbas);
+	destroyReorderCtx(pCtx);
+}
+
+typedef struct admissionEvents {
+	unsigned	count[2];		// Indexed by REORDER_EVENT_...
+	unsigned	lastPending;
+} admissionEvents_t;
+
+void countAdmissionEvent(reorder_ctx_t *pCtx, unsigned event, unsigned pending, void *pArg) {
+	admissionEvents_t	*pEvents=(admissionEvents_t *)pArg;
+
+	assert(event<=REORDER_EVENT_LOW_WATERMARK);
+	assert(pending==(unsigned)pCtx->cacheMgmt.tavl.active_nodes);
+	pEvents->count[event]++;
+	pEvents->lastPending=pending;
+}
+
+/**
+ *  @brief  Check that admission closes at the high watermark and opens at the low one with a callback each time,
+ *			that the selection sweeps in LBA while closed, and that every refusal is counted.
+ *  @param  None
+ *  @return None
+ */
+void checkAdmission(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(ADMISSION_TEST_NODES);
+	admissionConfig_t	config;
+	admissionEvents_t	events;
+	admissionStats_t	stats;
+	reorder_handle_t	handle;
+	segIdx_t			cNode;
+	unsigned			i, next, stride, lba, dist, expected, currentLba;
+	bool				completed=false;
+
+	printf("Checking admission control with watermarks %u/%u over %u nodes.\n", ADMISSION_TEST_HIGH, ADMISSION_TEST_LOW, ADMISSION_TEST_NODES);
+	stride=NUMBER_OF_BLOCKS/(ADMISSION_TEST_NODES+2*SUBMIT_RING_SIZE);
+	next=0;
+	memset(&events, 0, sizeof(events));
+	memset(&config, 0, sizeof(config));
+	config.highWatermark=ADMISSION_TEST_HIGH;
+	config.lowWatermark=ADMISSION_TEST_LOW;
+	config.sawtoothWhenClosed=true;
+	config.callback=countAdmissionEvent;
+	config.pArg=&events;
+	setAdmissionCtx(pCtx, &config);
+
+	// Admitted up to the high watermark, then busy. addLbaCtx() still fills the pool.
+	for (i=0; i<ADMISSION_TEST_HIGH; i++) {
+		assert(REORDER_ADMITTED==tryAddLbaCtx(pCtx, (next++)*stride, 1, i, &handle));
+		assert(getHandleLbaCtx(pCtx, handle)==(next-1)*stride);
+	}
+	assert((1==events.count[REORDER_EVENT_HIGH_WATERMARK]) && (ADMISSION_TEST_HIGH==events.lastPending));
+	assert(REORDER_BUSY==tryAddLbaCtx(pCtx, next*stride, 1, 0, NULL));
+	for (i=ADMISSION_TEST_HIGH; i<ADMISSION_TEST_NODES; i++) {
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pCtx, (next++)*stride, 1));
+	}
+	assert(REORDER_INVALID_HANDLE==addLbaCtx(pCtx, next*stride, 1));
+	assert(REORDER_BUSY==tryAddLbaCtx(pCtx, next*stride, 1, 0, NULL));
+
+	// Submissions stay queued while closed, until the ring is full.
+	for (i=0; submitLbaCtx(pCtx, (next+i)*stride, 1, 0x5b0000|i); i++) {
+	}
+	assert(SUBMIT_RING_SIZE==i);
+	assert(0==drainSubmissionsCtx(pCtx));
+
+	// Closed: each selection is the next pending entry in LBA, until the low watermark opens admission again.
+	while (0==events.count[REORDER_EVENT_LOW_WATERMARK]) {
+		assert(pCtx->admission.closed);
+		currentLba=pCtx->cacheMgmt.currentLba;
+		expected=UINT32_MAX;
+		for (cNode=tavlLink(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.lowest)->higher; cNode!=pCtx->cacheMgmt.tavl.highest; cNode=tavlLink(&pCtx->cacheMgmt.tavl, cNode)->higher) {
+			if ((UINT32_MAX==expected) || (completed && (pCtx->pSegmentPool[cNode].key>currentLba) && (expected<=currentLba))) {
+				expected=pCtx->pSegmentPool[cNode].key;
+			}
+		}
+		selectTargetLbaCtx(pCtx, &lba, &dist);
+		if (!pCtx->pStrategy->ownOrder) {
+			assert(lba==expected);
+		}
+		completeTargetCtx(pCtx, lba);
+		completed=true;
+	}
+	assert((ADMISSION_TEST_LOW==events.lastPending) && !pCtx->admission.closed);
+
+	// Open: the next selection drains the queued submissions, up to the high watermark.
+	selectTargetLbaCtx(pCtx, &lba, &dist);
+	assert(ADMISSION_TEST_HIGH==pCtx->cacheMgmt.tavl.active_nodes);
+	assert(2==events.count[REORDER_EVENT_HIGH_WATERMARK]);
+	assert(getLbaHandleCtx(pCtx, next*stride, &handle));
+
+	// Without watermarks, tryAddLbaCtx() only stops at a full pool.
+	setAdmissionCtx(pCtx, NULL);
+	assert(!pCtx->admission.closed);
+	next+=SUBMIT_RING_SIZE;
+	while (REORDER_ADMITTED==tryAddLbaCtx(pCtx, (next++)*stride, 1, 0, NULL)) {
+	}
+	assert(ADMISSION_TEST_NODES==pCtx->cacheMgmt.tavl.active_nodes);
+
+	getAdmissionStatsCtx(pCtx, &stats);
+	assert(2==stats.rejectedBusy);
+	assert(1==stats.rejectedFull);
+	assert(1==stats.rejectedRing);
+	assert(stats.deferred>=2);
+	assert(2==stats.closed);
+	assert(2==events.count[REORDER_EVENT_HIGH_WATERMARK]);
+	assert(1==events.count[REORDER_EVENT_LOW_WATERMARK]);
+	destroyReorderCtx(pCtx);
+}
+
+typedef struct strategyHooks {
+	unsigned	added, completed, freed;
+} strategyHooks_t;
+
+static strategyHooks_t	strategyHooks;
+
+// A strategy of the caller's own: always the lowest LBA, with every hook counted.
+segment_t *selectLowestLba(reorder_ctx_t *pCtx, unsigned *pDistance) {
+	segment_t	*tSeg=&pCtx->pSegmentPool[tavlLink(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.lowest)->higher];
+
+	getDistanceCtx(pCtx, pCtx->cacheMgmt.currentSg, pCtx->cacheMgmt.currentTrack, tSeg->sg, tSeg->track, pDistance);
+	return tSeg;
+}
+
+void countAdded(reorder_ctx_t *pCtx, segment_t *pSeg) {
+	reorder_handle_t	handle;
+
+	assert(getLbaHandleCtx(pCtx, pSeg->key, &handle) && (&pCtx->pSegmentPool[handle]==pSeg));
+	strategyHooks.added++;
+}
+
+void countCompleted(reorder_ctx_t *pCtx, segment_t *pSeg) {
+	assert(pCtx->cacheMgmt.currentLba==pSeg->key);
+	strategyHooks.completed++;
+}
+
+void countFreed(reorder_ctx_t *pCtx, segment_t *pSeg) {
+	reorder_handle_t	handle;
+
+	assert(getLbaHandleCtx(pCtx, pSeg->key, &handle) && (&pCtx->pSegmentPool[handle]==pSeg));
+	strategyHooks.freed++;
+}
+
+static const reorderStrategy_t lowestLbaStrategy={ "lowest LBA", selectLowestLba, countAdded, countCompleted, countFreed, false, 0, NULL, NULL };
+
+/**
+ *  @brief  Check that the strategy of a context can be switched between selections, through every built-in strategy
+ *			and one of the caller's own, without losing or duplicating any pending or queued entry.
+ *  @param  None
+ *  @return None
+ */
+void checkStrategies(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(STRATEGY_TEST_NODES);
+	const reorderStrategy_t	*pStrategy;
+	reorder_handle_t	handle;
+	uint64_t			tag;
+	unsigned			*lbas;
+	bool				*seen;
+	unsigned			i, lba, dist, next, strategy;
+	uint32_t			x=2463534242u;
+
+	printf("Checking strategy switches every %u selections over %u nodes.\n", STRATEGY_TEST_SWITCH, STRATEGY_TEST_NODES);
+	assert(NULL==getReorderStrategy(NUMBER_OF_STRATEGIES));
+	assert(getReorderStrategy(SELECTED_REORDERING)==pCtx->pStrategy);
+	lbas=malloc(STRATEGY_TEST_NODES*sizeof(unsigned));
+	seen=calloc(STRATEGY_TEST_NODES, sizeof(bool));
+	assert((NULL!=lbas) && (NULL!=seen));
+
+	// The tag of each entry is its slot in lbas[], so that every selection can be checked against what is pending.
+	strategy=0;
+	memset(&strategyHooks, 0, sizeof(strategyHooks));
+	for (i=0; i<STRATEGY_TEST_NODES+STRATEGY_TEST_LOOP; i++) {
+		next=i;
+		if (i>=STRATEGY_TEST_NODES) {
+			selectTargetHandleCtx(pCtx, &handle, &tag, &dist);
+			assert(tag<STRATEGY_TEST_NODES);
+			assert(getHandleLbaCtx(pCtx, handle)==lbas[tag]);
+			completeHandleCtx(pCtx, handle);
+			next=(unsigned)tag;
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (getLbaHandleCtx(pCtx, lba, &handle));
+		lbas[next]=lba;
+		if ((i>=STRATEGY_TEST_NODES) && (0==(i%STRATEGY_TEST_SWITCH))) {
+			// The replacement is still queued when the strategy changes.
+			assert(submitLbaCtx(pCtx, lba, 1, next));
+			strategy=(strategy+1)%(NUMBER_OF_STRATEGIES+1);
+			pStrategy=(NUMBER_OF_STRATEGIES==strategy)?&lowestLbaStrategy:getReorderStrategy(strategy);
+			setReorderStrategyCtx(pCtx, pStrategy);
+			assert(pStrategy==pCtx->pStrategy);
+			assert(STRATEGY_TEST_NODES==pCtx->cacheMgmt.tavl.active_nodes);
+			assert(0==pCtx->dpReorder.totalReordered);
+		} else {
+			assert(REORDER_INVALID_HANDLE!=addLbaTaggedCtx(pCtx, lba, 1, next));
+		}
+	}
+	assert(STRATEGY_TEST_NODES==pCtx->cacheMgmt.tavl.active_nodes);
+	assert(tavlHeightCheck(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.root));
+	// Every hook of the own strategy ran while it was selected, once per entry.
+	assert((strategyHooks.completed>0) && (strategyHooks.completed==strategyHooks.freed));
+	assert(strategyHooks.added>0);
+
+	// Select out everything with the default strategy. Each entry comes out exactly once.
+	setReorderStrategyCtx(pCtx, getReorderStrategy(SELECTED_REORDERING));
+	for (i=0; i<STRATEGY_TEST_NODES; i++) {
+		selectTargetHandleCtx(pCtx, &handle, &tag, &dist);
+		assert((tag<STRATEGY_TEST_NODES) && !seen[tag]);
+		assert(getHandleLbaCtx(pCtx, handle)==lbas[tag]);
+		seen[tag]=true;
+		completeHandleCtx(pCtx, handle);
+	}
+	assert(0==pCtx->cacheMgmt.tavl.active_nodes);
+	free(lbas);
+	free(seen);
+	destroyReorderCtx(pCtx);
+}
+
+/**
+ *  @brief  Select and complete the given number of targets, adding a new random entry after each
+ *  @param  reorder_ctx_t *pCtx - context, unsigned n - number of selections, uint32_t *pX - state of the random LBAs
+ *  @return None
+ */
+void runSelections(reorder_ctx_t *pCtx, unsigned n, uint32_t *pX) {
+	reorder_handle_t	handle;
+	unsigned			i, lba, dist;
+
+	for (i=0; i<n; i++) {
+		selectTargetLbaCtx(pCtx, &lba, &dist);
+		completeTargetCtx(pCtx, lba);
+		do {
+			*pX^=*pX<<13; *pX^=*pX>>17; *pX^=*pX<<5;
+			lba=*pX%NUMBER_OF_BLOCKS;
+		} while (getLbaHandleCtx(pCtx, lba, &handle));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pCtx, lba, 1));
+	}
+}
+
+/**
+ *  @brief  Check that the governor keeps off sawtooth when the CPU budget allows better, steps down to it when
+ *			nothing fits the budget, and counts every decision.
+ *  @param  None
+ *  @return None
+ */
+void checkGovernor(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(GOVERNOR_TEST_NODES);
+	governorConfig_t	config;
+	governorStats_t		stats;
+	unsigned			i, lba;
+	uint32_t			x=1013904223u;
+
+	printf("Checking the strategy governor over %u nodes.\n", GOVERNOR_TEST_NODES);
+	for (i=0; i<GOVERNOR_TEST_NODES; i++) {
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (NULL_SEG_IDX!=searchAvl(&pCtx->cacheMgmt.tavl, lba));
+		(void)addLbaCtx(pCtx, lba, 1);
+	}
+
+	// A budget nothing goes over. It starts on the default levels at the current strategy, the top one, tries the cheaper ones,
+	// and comes back above sawtooth, which travels much farther at this depth.
+	memset(&config, 0, sizeof(config));
+	config.cpuBudgetNs=1000000000u;
+	config.window=GOVERNOR_TEST_WINDOW;
+	config.probeWindows=16;
+	setReorderStrategyCtx(pCtx, getReorderStrategy(SHORTEST_DIST_WITHIN_RANGE));
+	setGovernorCtx(pCtx, &config);
+	getGovernorStatsCtx(pCtx, &stats);
+	assert((getReorderStrategy(SHORTEST_DIST_WITHIN_RANGE)==pCtx->pStrategy) && (2==stats.level));
+	runSelections(pCtx, GOVERNOR_TEST_WINDOW*GOVERNOR_TEST_WINDOWS, &x);
+	getGovernorStatsCtx(pCtx, &stats);
+	printf("Governor: level %u, depth %u, SG per I/O x16 %u/%u/%u, ns per selection %u/%u/%u, up %llu, down %llu, probes %llu.\n",
+		stats.level, stats.depth, stats.sgPerIo[0], stats.sgPerIo[1], stats.sgPerIo[2], stats.nsPerSelection[0], stats.nsPerSelection[1], stats.nsPerSelection[2],
+		(unsigned long long)stats.stepsUp, (unsigned long long)stats.stepsDown, (unsigned long long)stats.probes);
+	assert((GOVERNOR_TEST_WINDOW*GOVERNOR_TEST_WINDOWS==stats.selections) && (GOVERNOR_TEST_WINDOWS==stats.windows));
+	assert(0==stats.cpuLimited);
+	assert((stats.stepsDown>=2) && (stats.probes>=2));
+	assert(stats.sgPerIo[0]>stats.sgPerIo[1]);
+	assert((0!=stats.level) && (pCtx->pStrategy!=getReorderStrategy(LBA_SAWTOOTH_REORDERING)));
+	assert((stats.depth>=GOVERNOR_TEST_NODES-1) && (stats.depth<=GOVERNOR_TEST_NODES));
+
+	// Every level is over a budget of 1ns. Down a level a window until sawtooth, and never up.
+	config.cpuBudgetNs=1;
+	setGovernorCtx(pCtx, &config);
+	runSelections(pCtx, GOVERNOR_TEST_WINDOW*GOVERNOR_TEST_WINDOWS, &x);
+	getGovernorStatsCtx(pCtx, &stats);
+	assert((0==stats.level) && (pCtx->pStrategy==getReorderStrategy(LBA_SAWTOOTH_REORDERING)));
+	assert((stats.cpuLimited==stats.stepsDown) && (stats.cpuLimited<=2) && (0==stats.stepsUp));
+
+	// Off. Nothing is counted any more.
+	setGovernorCtx(pCtx, NULL);
+	runSelections(pCtx, GOVERNOR_TEST_WINDOW, &x);
+	getGovernorStatsCtx(pCtx, &stats);
+	assert((0==stats.selections) && (0==stats.windows));
+	assert(GOVERNOR_TEST_NODES==pCtx->cacheMgmt.tavl.active_nodes);
+	destroyReorderCtx(pCtx);
+}
+
+/**
+ *  @brief  Check the range of each tuning parameter and what depends on it, that the tuner leaves strategies without
+ *			parameters alone, and that it climbs the shortest distance & LBA factor away from a poor value.
+ *  @param  None
+ *  @return None
+ */
+void checkTuner(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(GOVERNOR_TEST_NODES);
+	tunerConfig_t		config;
+	tunerStats_t		stats;
+	unsigned			i, lba, halfRev;
+	uint32_t			x=362436069u;
+
+	printf("Checking the online tuner over %u nodes.\n", GOVERNOR_TEST_NODES);
+	halfRev=pCtx->pInvSeekProfile[NUMBER_OF_SG>>1];
+	assert((halfRev==pCtx->cacheMgmt.maxTrackRange) && ((halfRev>>1)==pCtx->cacheMgmt.maxBacktrack));
+	assert(!setTuningCtx(pCtx, TUNE_TRACK_RANGE, 0) && !setTuningCtx(pCtx, TUNE_BACKTRACK, 9) && !setTuningCtx(pCtx, NUMBER_OF_TUNABLES, 1));
+	assert(!setTuningCtx(pCtx, TUNE_AND_LBA, 7) && !setTuningCtx(pCtx, TUNE_AND_LBA, 17));
+	assert(setTuningCtx(pCtx, TUNE_TRACK_RANGE, 4) && ((halfRev>>1)==pCtx->cacheMgmt.maxTrackRange) && ((halfRev>>2)==pCtx->cacheMgmt.maxBacktrack));
+	assert(setTuningCtx(pCtx, TUNE_BACKTRACK, 8) && (pCtx->cacheMgmt.maxTrackRange==pCtx->cacheMgmt.maxBacktrack));
+	assert(setTuningCtx(pCtx, TUNE_TRACK_RANGE, TUNE_TRACK_RANGE_DEFAULT) && setTuningCtx(pCtx, TUNE_BACKTRACK, TUNE_BACKTRACK_DEFAULT));
+	assert((halfRev==pCtx->cacheMgmt.maxTrackRange) && ((halfRev>>1)==pCtx->cacheMgmt.maxBacktrack));
+	for (i=0; i<GOVERNOR_TEST_NODES; i++) {
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (NULL_SEG_IDX!=searchAvl(&pCtx->cacheMgmt.tavl, lba));
+		(void)addLbaCtx(pCtx, lba, 1);
+	}
+
+	// Zeros select the defaults.
+	memset(&config, 0, sizeof(config));
+	setTunerCtx(pCtx, &config);
+	assert((TUNER_DEFAULT_WINDOW==pCtx->tuner.config.window) && (TUNER_DEFAULT_GAIN==pCtx->tuner.config.minGainPermille));
+
+	// Shortest distance has nothing to tune. Only baselines are measured.
+	setReorderStrategyCtx(pCtx, getReorderStrategy(SHORTEST_DIST));
+	config.window=TUNER_TEST_WINDOW;
+	setTunerCtx(pCtx, &config);
+	runSelections(pCtx, TUNER_TEST_WINDOW*4, &x);
+	getTunerStatsCtx(pCtx, &stats);
+	assert((4==stats.windows) && (0==stats.trials) && (0!=stats.sgPerIo));
+
+	// Taking the shortest distance only when it is under half the distance to the next LBA travels much farther.
+	setReorderStrategyCtx(pCtx, getReorderStrategy(SHORTEST_DIST_AND_LBA));
+	assert(setTuningCtx(pCtx, TUNE_AND_LBA, 16));
+	setTunerCtx(pCtx, &config);
+	runSelections(pCtx, TUNER_TEST_WINDOW*TUNER_TEST_WINDOWS, &x);
+	getTunerStatsCtx(pCtx, &stats);
+	printf("Tuner: trials %llu, kept %llu, TUNE_AND_LBA %u/8, SG per I/O x16 %u.\n",
+		(unsigned long long)stats.trials, (unsigned long long)stats.kept, stats.value[TUNE_AND_LBA], stats.sgPerIo);
+	assert((TUNER_TEST_WINDOWS==stats.windows) && (TUNER_TEST_WINDOWS/2==stats.trials) && (stats.trials==stats.kept+stats.reverted));
+	assert((stats.kept>=1) && (stats.value[TUNE_AND_LBA]<=14));
+	assert((TUNE_TRACK_RANGE_DEFAULT==stats.value[TUNE_TRACK_RANGE]) && (TUNE_BACKTRACK_DEFAULT==stats.value[TUNE_BACKTRACK]));
+	assert(TUNE_SIDE_TRIP_DEFAULT==stats.value[TUNE_SIDE_TRIP]);
+
+	// Off, with the kept values in place.
+	setTunerCtx(pCtx, NULL);
+	assert(stats.value[TUNE_AND_LBA]==pCtx->cacheMgmt.tune[TUNE_AND_LBA]);
+	runSelections(pCtx, TUNER_TEST_WINDOW, &x);
+	getTunerStatsCtx(pCtx, &stats);
+	assert((0==stats.windows) && (GOVERNOR_TEST_NODES==pCtx->cacheMgmt.tavl.active_nodes));
+	destroyReorderCtx(pCtx);
+}
+
+// SHORTEST_DIST_WITHIN_RANGE as three separate sweeps: within range, shortest distance, then back into the range.
+segment_t *selectWithinRangeBySweeps(reorder_ctx_t *pCtx, unsigned *pDistance) {
+	unsigned	rangeBottom, shortestDist, shortestDistWithinRange, returnDist;
+	segment_t	*shortestDistNode, *shortestDistNodeWithinRange, *returnDistNode;
+	segIdx_t	tNode;
+
+	if (NULL==pCtx->dpReorder.lbaRangeFirst) {
+		tNode=tavlLink(&pCtx->cacheMgmt.tavl, searchTavl(&pCtx->cacheMgmt.tavl, pCtx->dpReorder.lastLba))->higher;
+		pCtx->dpReorder.lbaRangeFirst=&pCtx->pSegmentPool[tNode];
+		pCtx->dpReorder.lbaRangeLast=&pCtx->pSegmentPool[tNode];
+	}
+	rangeBottom=(pCtx->dpReorder.lbaRangeFirst->track>pCtx->cacheMgmt.maxBacktrack)?pCtx->dpReorder.lbaRangeFirst->track-pCtx->cacheMgmt.maxBacktrack:0;
+	shortestDistNodeWithinRange=selectTargetWithinTracks(pCtx, pCtx->cacheMgmt.currentLba, pCtx->cacheMgmt.currentSg, pCtx->cacheMgmt.currentTrack,
+		rangeBottom, MIN(pCtx->cacheMgmt.currentTrack+pCtx->cacheMgmt.maxTrackRange, NUMBER_OF_TRACKS-1), &shortestDistWithinRange);
+	shortestDistNode=selectTarget(pCtx, pCtx->cacheMgmt.currentLba, pCtx->cacheMgmt.currentSg, pCtx->cacheMgmt.currentTrack, &shortestDist);
+	if ((NULL==shortestDistNodeWithinRange) || (shortestDistNodeWithinRange==shortestDistNode)) {
+		*pDistance=shortestDist;
+		return shortestDistNode;
+	}
+	returnDistNode=selectTargetWithinTracks(pCtx, shortestDistNode->key, shortestDistNode->sg, shortestDistNode->track,
+		rangeBottom, MIN(shortestDistNode->track+pCtx->cacheMgmt.maxTrackRange, NUMBER_OF_TRACKS-1), &returnDist);
+	if ((NULL!=returnDistNode) && ((shortestDist+returnDist)<=((shortestDistWithinRange*(8+pCtx->cacheMgmt.tune[TUNE_SIDE_TRIP]))>>3))) {
+		*pDistance=shortestDist;
+		return shortestDistNode;
+	}
+	*pDistance=shortestDistWithinRange;
+	return shortestDistNodeWithinRange;
+}
+
+/**
+ *  @brief  Check that SHORTEST_DIST_WITHIN_RANGE picks the same targets as selectWithinRangeBySweeps() on the same workload,
+ *			with the default parameters, a wide side trip allowance with no backtrack, and a narrow track range, then drained.
+ *  @param  None
+ *  @return None
+ */
+void checkWithinRange(void) {
+	reorder_ctx_t		*pA=createReorderCtx(RANGE_TEST_NODES);
+	reorder_ctx_t		*pB=createReorderCtx(RANGE_TEST_NODES);
+	reorderStrategy_t	bySweeps=*getReorderStrategy(SHORTEST_DIST_WITHIN_RANGE);
+	unsigned			i, lba, lbaA, lbaB, distA, distB;
+	uint32_t			x=521288629u;
+
+	printf("Checking shortest distance within range against three separate sweeps.\n");
+	bySweeps.name="shortest distance within range by sweeps";
+	bySweeps.select=selectWithinRangeBySweeps;
+	setReorderStrategyCtx(pA, getReorderStrategy(SHORTEST_DIST_WITHIN_RANGE));
+	setReorderStrategyCtx(pB, &bySweeps);
+	for (i=0; i<RANGE_TEST_NODES+RANGE_TEST_LOOP; i++) {
+		if (RANGE_TEST_NODES+RANGE_TEST_LOOP/3==i) {
+			assert(setTuningCtx(pA, TUNE_SIDE_TRIP, 8) && setTuningCtx(pB, TUNE_SIDE_TRIP, 8));
+			assert(setTuningCtx(pA, TUNE_BACKTRACK, 0) && setTuningCtx(pB, TUNE_BACKTRACK, 0));
+		} else if (RANGE_TEST_NODES+2*RANGE_TEST_LOOP/3==i) {
+			assert(setTuningCtx(pA, TUNE_TRACK_RANGE, 1) && setTuningCtx(pB, TUNE_TRACK_RANGE, 1));
+		}
+		if (i>=RANGE_TEST_NODES) {
+			selectTargetLbaCtx(pA, &lbaA, &distA);
+			selectTargetLbaCtx(pB, &lbaB, &distB);
+			assert((lbaA==lbaB) && (distA==distB));
+			completeTargetCtx(pA, lbaA);
+			completeTargetCtx(pB, lbaB);
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (NULL_SEG_IDX!=searchAvl(&pA->cacheMgmt.tavl, lba));
+		(void)addLbaCtx(pA, lba, 1);
+		(void)addLbaCtx(pB, lba, 1);
+	}
+	// Drain both, the side trips get more frequent as the queue gets sparse.
+	while (NULL_SEG_IDX!=pA->cacheMgmt.tavl.root) {
+		selectTargetLbaCtx(pA, &lbaA, &distA);
+		selectTargetLbaCtx(pB, &lbaB, &distB);
+		assert((lbaA==lbaB) && (distA==distB));
+		completeTargetCtx(pA, lbaA);
+		completeTargetCtx(pB, lbaB);
+	}
+	checkSameNodes(pA, pB);
+	destroyReorderCtx(pA);
+	destroyReorderCtx(pB);
+}
+
+/**
+ *  @brief  Check that LOOKAHEAD of depth 1 and width 1 picks the same targets as SHORTEST_DIST, and that deeper lookaheads
+ *			take a shorter total distance than SHORTEST_DIST on the same workload, then drained.
+ *  @param  None
+ *  @return None
+ */
+void checkLookahead(void) {
+	reorder_ctx_t		*pCtx[4];
+	reorder_handle_t	handle;
+	uint64_t			total[4]={ 0 };
+	unsigned			i, j, lba, lbaCtx, dist, distGreedy;
+	uint32_t			x=88675123u;
+
+	printf("Checking lookahead against shortest distance.\n");
+	for (j=0; j<4; j++) {
+		pCtx[j]=createReorderCtx(LOOKAHEAD_TEST_NODES);
+		setReorderStrategyCtx(pCtx[j], getReorderStrategy((0==j)?SHORTEST_DIST:LOOKAHEAD));
+	}
+	assert(!setLookaheadCtx(pCtx[1], 0, 1) && !setLookaheadCtx(pCtx[1], LOOKAHEAD_MAX_DEPTH+1, 1));
+	assert(!setLookaheadCtx(pCtx[1], 1, 0) && !setLookaheadCtx(pCtx[1], 1, LOOKAHEAD_MAX_WIDTH+1));
+	assert((LOOKAHEAD_DEFAULT_DEPTH==pCtx[1]->lookahead.depth) && (LOOKAHEAD_DEFAULT_WIDTH==pCtx[1]->lookahead.width));
+	assert(setLookaheadCtx(pCtx[1], 1, 1));
+	assert(setLookaheadCtx(pCtx[3], 3, 4));
+	for (i=0; i<LOOKAHEAD_TEST_NODES+LOOKAHEAD_TEST_LOOP; i++) {
+		if (i>=LOOKAHEAD_TEST_NODES) {
+			for (j=0; j<4; j++) {
+				selectTargetLbaCtx(pCtx[j], &lbaCtx, &dist);
+				if (0==j) {
+					lba=lbaCtx;
+					distGreedy=dist;
+				} else if (1==j) {
+					assert((lbaCtx==lba) && (dist==distGreedy));
+				}
+				total[j]+=dist;
+				completeTargetCtx(pCtx[j], lbaCtx);
+			}
+		}
+		// The contexts complete different entries, so the new one must be new to all of them.
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+			for (j=0; (j<4) && !getLbaHandleCtx(pCtx[j], lba, &handle); j++);
+		} while (j<4);
+		for (j=0; j<4; j++) {
+			assert(REORDER_INVALID_HANDLE!=addLbaCtx(pCtx[j], lba, 1));
+		}
+	}
+	// Drain, down to paths shorter than the depth.
+	for (j=0; j<4; j++) {
+		while (NULL_SEG_IDX!=pCtx[j]->cacheMgmt.tavl.root) {
+			selectTargetLbaCtx(pCtx[j], &lbaCtx, &dist);
+			total[j]+=dist;
+			completeTargetCtx(pCtx[j], lbaCtx);
+		}
+	}
+	printf("Total distance of shortest distance %llu, lookahead %ux%u %llu, 3x4 %llu.\n", (unsigned long long)total[0],
+		LOOKAHEAD_DEFAULT_DEPTH, LOOKAHEAD_DEFAULT_WIDTH, (unsigned long long)total[2], (unsigned long long)total[3]);
+	assert(total[1]==total[0]);
+	assert((total[2]<total[0]) && (total[3]<total[0]));
+	for (j=0; j<4; j++) {
+		destroyReorderCtx(pCtx[j]);
+	}
+}
+
+/**
+ *  @brief  Shortest distance through every entry of the given set not used yet, from the given position, tried in every order.
+ *  @param  reorder_ctx_t *pCtx - context, unsigned sg, unsigned track - position, const unsigned *pLba - set,
+ *			unsigned n - entries in the set, unsigned used - bit of each entry used already
+ *  @return the shortest distance
+ */
+unsigned getShortestOrderDist(reorder_ctx_t *pCtx, unsigned sg, unsigned track, const unsigned *pLba, unsigned n, unsigned used) {
+	unsigned	i, sgNext, trackNext, dist, cost, best=UINT32_MAX;
+
+	if (used==(1u<<n)-1) {
+		return 0;
+	}
+	for (i=0; i<n; i++) {
+		if (0==(used&(1u<<i))) {
+			getPhyFromLba(pLba[i], &sgNext, &trackNext);
+			getDistanceCtx(pCtx, sg, track, sgNext, trackNext, &dist);
+			cost=dist+getShortestOrderDist(pCtx, sgNext, trackNext, pLba, n, used|(1u<<i));
+			best=MIN(best, cost);
+		}
+	}
+	return best;
+}
+
+/**
+ *  @brief  Check that WINDOW_DP drains a set that fits in its window in the shortest order there is, found by trying every order,
+ *			and no longer than SHORTEST_DIST, then that with hops of a path left over while other entries are completed,
+ *			every selection is still pending.
+ *  @param  None
+ *  @return None
+ */
+void checkWindowDp(void) {
+	reorder_ctx_t		*pCtx, *pGreedy;
+	reorder_handle_t	handle;
+	unsigned			lbas[WINDOW_TEST_SET_SIZE];
+	unsigned			pending[WINDOW_TEST_NODES];
+	unsigned			t, i, j, lba, dist, total, totalGreedy, shortest;
+	uint32_t			x=362436069u;
+
+	printf("Checking window DP against every order.\n");
+	pCtx=createReorderCtx(WINDOW_TEST_NODES);
+	setReorderStrategyCtx(pCtx, getReorderStrategy(WINDOW_DP));
+	assert(!setWindowDpCtx(pCtx, 1, 1, 1) && !setWindowDpCtx(pCtx, WINDOW_DP_MAX_WINDOW+1, 1, 1));
+	assert(!setWindowDpCtx(pCtx, 4, 0, 1) && !setWindowDpCtx(pCtx, 4, 5, 1));
+	assert(!setWindowDpCtx(pCtx, 4, 2, 0) && !setWindowDpCtx(pCtx, 4, 2, 3));
+	assert((WINDOW_DP_DEFAULT_WINDOW==pCtx->windowDp.window) && (WINDOW_DP_DEFAULT_DEPTH==pCtx->windowDp.depth)
+		&& (WINDOW_DP_DEFAULT_HOPS==pCtx->windowDp.hops));
+	// A path as deep as the window and taken whole is the shortest order of the set.
+	assert(setWindowDpCtx(pCtx, WINDOW_TEST_SET_SIZE+1, WINDOW_TEST_SET_SIZE+1, WINDOW_TEST_SET_SIZE+1));
+	pGreedy=createReorderCtx(WINDOW_TEST_NODES);
+	setReorderStrategyCtx(pGreedy, getReorderStrategy(SHORTEST_DIST));
+	for (t=0; t<WINDOW_TEST_SETS; t++) {
+		for (i=0; i<WINDOW_TEST_SET_SIZE; i++) {
+			do {
+				x^=x<<13; x^=x>>17; x^=x<<5;
+				lbas[i]=x%NUMBER_OF_BLOCKS;
+			} while (getLbaHandleCtx(pCtx, lbas[i], &handle));
+			assert(REORDER_INVALID_HANDLE!=addLbaCtx(pCtx, lbas[i], 1));
+			assert(REORDER_INVALID_HANDLE!=addLbaCtx(pGreedy, lbas[i], 1));
+		}
+		// Both start from where the last set ended, the same for both only on the first set.
+		shortest=getShortestOrderDist(pCtx, pCtx->cacheMgmt.currentSg, pCtx->cacheMgmt.currentTrack, lbas, WINDOW_TEST_SET_SIZE, 0);
+		total=totalGreedy=0;
+		for (i=0; i<WINDOW_TEST_SET_SIZE; i++) {
+			selectTargetLbaCtx(pCtx, &lba, &dist);
+			total+=dist;
+			completeTargetCtx(pCtx, lba);
+			selectTargetLbaCtx(pGreedy, &lba, &dist);
+			totalGreedy+=dist;
+			completeTargetCtx(pGreedy, lba);
+		}
+		assert(total==shortest);
+		assert((0!=t) || (total<=totalGreedy));
+		assert(NULL_SEG_IDX==pCtx->cacheMgmt.tavl.root);
+	}
+	destroyReorderCtx(pGreedy);
+
+	// Every third completion is of a random pending entry instead of the selected one, which may be a hop left of a path.
+	assert(setWindowDpCtx(pCtx, WINDOW_DP_MAX_WINDOW, 4, 4));
+	for (i=0; i<WINDOW_TEST_NODES+WINDOW_TEST_LOOP; i++) {
+		if (i>=WINDOW_TEST_NODES) {
+			selectTargetLbaCtx(pCtx, &lba, &dist);
+			for (j=0; pending[j]!=lba; j++) {
+				assert(j<WINDOW_TEST_NODES-1);
+			}
+			if (0==(i%3)) {
+				j=x%WINDOW_TEST_NODES;
+			}
+			completeTargetCtx(pCtx, pending[j]);
+		} else {
+			j=i;
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (getLbaHandleCtx(pCtx, lba, &handle));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pCtx, lba, 1));
+		pending[j]=lba;
+	}
+	destroyReorderCtx(pCtx);
+}
+
+/**
+ *  @brief  Check the selection budget with every built-in strategy. With a budget nothing reaches, the selections are the same
+ *			as without one. With budgets of 1 and 30 operations and of 1ns, every selection is a pending entry at the distance given,
+ *			and the counters add up, with the 1 operation budget falling back to the next in LBA on the strategies that only sweep.
+ *  @param  None
+ *  @return None
+ */
+void checkSelectBudget(void) {
+	const selectBudgetConfig_t	config[]={ { 0xffffffffu, 0 }, { 1, 0 }, { 30, 0 }, { 0, 1 } };
+	reorder_ctx_t		*pA, *pB;
+	reorder_handle_t	handle;
+	selectBudgetStats_t	stats;
+	unsigned			c, strategy, i, lba, lbaA, lbaB, distA, distB, dist;
+	uint32_t			x;
+
+	printf("Checking the selection budget of every strategy.\n");
+	for (c=0; c<sizeof(config)/sizeof(config[0]); c++) {
+		for (strategy=0; strategy<NUMBER_OF_STRATEGIES; strategy++) {
+			pA=createReorderCtx(BUDGET_TEST_NODES);
+			pB=createReorderCtx(BUDGET_TEST_NODES);
+			setReorderStrategyCtx(pA, getReorderStrategy(strategy));
+			setReorderStrategyCtx(pB, getReorderStrategy(strategy));
+			setSelectBudgetCtx(pA, &config[c]);
+			x=362436069u+strategy;
+			for (i=0; i<BUDGET_TEST_NODES+BUDGET_TEST_LOOP; i++) {
+				if (i>=BUDGET_TEST_NODES) {
+					selectTargetLbaCtx(pA, &lbaA, &distA);
+					selectTargetLbaCtx(pB, &lbaB, &distB);
+					assert(getLbaHandleCtx(pA, lbaA, &handle));
+					getDistanceCtx(pA, pA->cacheMgmt.currentSg, pA->cacheMgmt.currentTrack,
+						pA->pSegmentPool[handle].sg, pA->pSegmentPool[handle].track, &dist);
+					// The sweeps take another entry on the same SG and track as no distance, getDistanceCtx() as a revolution.
+					assert((dist==distA) || ((0==distA) && (NUMBER_OF_SG==dist)));
+					if (0==c) {
+						assert((lbaA==lbaB) && (distA==distB));
+					}
+					completeTargetCtx(pA, lbaA);
+					completeTargetCtx(pB, lbaB);
+				}
+				do {
+					x^=x<<13; x^=x>>17; x^=x<<5;
+					lba=x%NUMBER_OF_BLOCKS;
+				} while (getLbaHandleCtx(pA, lba, &handle) || getLbaHandleCtx(pB, lba, &handle));
+				assert(REORDER_INVALID_HANDLE!=addLbaCtx(pA, lba, 1));
+				assert(REORDER_INVALID_HANDLE!=addLbaCtx(pB, lba, 1));
+			}
+			getSelectBudgetStatsCtx(pA, &stats);
+			assert((BUDGET_TEST_LOOP==stats.selections) && (stats.fallbacks<=stats.cutShort) && (stats.cutShort<=stats.selections));
+			if (0==c) {
+				assert((0==stats.cutShort) && stats.finished);
+			} else if ((1==c) && (LBA_SAWTOOTH_REORDERING!=strategy)) {
+				// The first step runs it out
+				assert((BUDGET_TEST_LOOP==stats.cutShort) && !stats.finished);
+				// Shortest distance & LBA has the next in LBA itself, path building the first entry it placed.
+				if ((SHORTEST_DIST==strategy) || (SHORTEST_DIST_WITHIN_RANGE==strategy) || (LOOKAHEAD==strategy)) {
+					assert(BUDGET_TEST_LOOP==stats.fallbacks);
+				}
+			}
+			// Off again
+			setSelectBudgetCtx(pA, NULL);
+			selectTargetLbaCtx(pA, &lbaA, &distA);
+			getSelectBudgetStatsCtx(pA, &stats);
+			assert((0==stats.selections) && stats.finished);
+			destroyReorderCtx(pA);
+			destroyReorderCtx(pB);
+		}
+	}
+}
+
+/**
+ *  @brief  Check that path building planned with planReorderCtx() after every completion and new entry selects the same
+ *			as filling the reordered list in the selection, then that planning a single entry at a time, which falls behind,
+ *			still selects every pending entry once, and that strategies without a plan hook plan nothing.
+ *  @param  None
+ *  @return None
+ */
+void checkPlanner(void) {
+	reorder_ctx_t		*pA=createReorderCtx(PLANNER_TEST_NODES);
+	reorder_ctx_t		*pB=createReorderCtx(PLANNER_TEST_NODES);
+	reorder_handle_t	handle;
+	unsigned			i, lba, lbaA, lbaB, distA, distB, planned;
+	uint32_t			x=1234567u;
+
+	printf("Checking planned path building against filling in the selection.\n");
+	setReorderStrategyCtx(pA, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+	setReorderStrategyCtx(pB, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+	setPlannerCtx(pB, true);
+	planned=0;
+	for (i=0; i<PLANNER_TEST_NODES+PLANNER_TEST_LOOP; i++) {
+		if (i>=PLANNER_TEST_NODES) {
+			selectTargetLbaCtx(pA, &lbaA, &distA);
+			selectTargetLbaCtx(pB, &lbaB, &distB);
+			if (i<PLANNER_TEST_NODES+PLANNER_TEST_LOOP/2) {
+				assert((lbaA==lbaB) && (distA==distB));
+			}
+			completeTargetCtx(pA, lbaA);
+			completeTargetCtx(pB, lbaB);
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (getLbaHandleCtx(pA, lba, &handle) || getLbaHandleCtx(pB, lba, &handle));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pA, lba, 1));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pB, lba, 1));
+		// The second half plans one entry at a time, fewer than are added and selected.
+		if (i>=PLANNER_TEST_NODES-1) {
+			planned+=planReorderCtx(pB, (i<PLANNER_TEST_NODES+PLANNER_TEST_LOOP/2)?NUMBER_OF_REORDERED:(i&1));
+			assert(pB->dpReorder.totalReordered==MIN(PLANNER_TEST_NODES, NUMBER_OF_REORDERED) || (i>=PLANNER_TEST_NODES+PLANNER_TEST_LOOP/2));
+		}
+	}
+	assert(planned>=PLANNER_TEST_LOOP/2);
+	// Drain B, every entry comes out once.
+	for (i=0; i<PLANNER_TEST_NODES; i++) {
+		selectTargetLbaCtx(pB, &lbaB, &distB);
+		assert(getLbaHandleCtx(pB, lbaB, &handle));
+		completeTargetCtx(pB, lbaB);
+	}
+	assert((0==pB->cacheMgmt.tavl.active_nodes) && (0==pB->dpReorder.totalReordered));
+	// Nothing to plan for a strategy without the hook
+	setReorderStrategyCtx(pA, getReorderStrategy(SHORTEST_DIST));
+	assert(0==planReorderCtx(pA, NUMBER_OF_REORDERED));
+	destroyReorderCtx(pA);
+	destroyReorderCtx(pB);
+}
+
+/**
+ *  @brief  Check that path building planned by the planner thread of startPlannerCtx(), let catch up after every new entry,
+ *			selects the same as filling the reordered list in the selection, then that selecting along with the thread,
+ *			which falls behind, still selects every pending entry once. Without the planner thread built in, check it does not start.
+ *  @param  None
+ *  @return None
+ */
+void checkPlannerThread(void) {
+	reorder_ctx_t		*pA=createReorderCtx(PLANNER_TEST_NODES);
+	reorder_ctx_t		*pB=createReorderCtx(PLANNER_TEST_NODES);
+#if (SELECTED_PLANNER_THREAD==PLANNER_THREAD_POSIX)
+	plannerConfig_t		config={ 1 };
+	plannerStats_t		stats;
+	reorder_handle_t	handle;
+	unsigned			i, lba, lbaA, lbaB, distA, distB, added;
+	uint32_t			x=2345678u;
+
+	printf("Checking the planner thread against filling in the selection.\n");
+	setReorderStrategyCtx(pA, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+	setReorderStrategyCtx(pB, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+	added=0;
+	for (i=0; i<PLANNER_TEST_NODES+PLANNER_TEST_LOOP; i++) {
+		if (i>=PLANNER_TEST_NODES) {
+			selectTargetLbaCtx(pB, &lbaB, &distB);
+			// In the second half, A only follows B, so that both have the same entries pending.
+			if (i<PLANNER_TEST_NODES+PLANNER_TEST_LOOP/2) {
+				selectTargetLbaCtx(pA, &lbaA, &distA);
+				assert((lbaA==lbaB) && (distA==distB));
+			}
+			completeTargetCtx(pA, lbaB);
+			completeTargetCtx(pB, lbaB);
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (getLbaHandleCtx(pA, lba, &handle));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pA, lba, 1));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pB, lba, 1));
+		// Start once the first entries are in, as the list a fill places them in depends on what is pending.
+		if (i==PLANNER_TEST_NODES-1) {
+			assert(startPlannerCtx(pB, &config));
+			assert(!startPlannerCtx(pB, NULL));
+			added=PLANNER_TEST_NODES;
+		} else if (i>=PLANNER_TEST_NODES) {
+			added++;
+		}
+		// The first half waits for the thread to place every entry, the second half selects along with it.
+		if ((i>=PLANNER_TEST_NODES-1) && (i<PLANNER_TEST_NODES+PLANNER_TEST_LOOP/2)) {
+			do {
+				getPlannerStatsCtx(pB, &stats);
+			} while (stats.placed<added);
+			assert(stats.placed==added);
+		}
+	}
+	stopPlannerCtx(pB);
+	// Drain B, every entry comes out once.
+	for (i=0; i<PLANNER_TEST_NODES; i++) {
+		selectTargetLbaCtx(pB, &lbaB, &distB);
+		assert(getLbaHandleCtx(pB, lbaB, &handle));
+		completeTargetCtx(pB, lbaB);
+	}
+	assert((0==pB->cacheMgmt.tavl.active_nodes) && (0==pB->dpReorder.totalReordered));
+#else
+	assert(!startPlannerCtx(pB, NULL));
+#endif
+	destroyReorderCtx(pA);
+	destroyReorderCtx(pB);
+}
+
+/**
+ *  @brief  Check that the bounds of the link index of path building stay above every link of the reordered list,
+ *			and the cached link distances and the planned path length stay exact, while entries are completed out of
+ *			the middle of it too and the strategy is switched away and back.
+ *			reorderNewEntry() asserts that no link left out by the index has room for the new entry.
+ *  @param  None
+ *  @return None
+ */
+void checkLinkIndex(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(LINK_TEST_NODES);
+	reorder_handle_t	handle;
+	segment_t			*pSeg, *pNext;
+	unsigned			pending[LINK_TEST_NODES];
+	unsigned			i, j, lba, dist, linkDist, pathDist, entries, plannedDist;
+	uint32_t			x=7654321u;
+
+	printf("Checking the link index of path building.\n");
+	setReorderStrategyCtx(pCtx, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+	for (i=0; i<LINK_TEST_NODES+LINK_TEST_LOOP; i++) {
+		if (i>=LINK_TEST_NODES) {
+			// Every third completion is of a random pending entry instead of the selected one.
+			j=x%LINK_TEST_NODES;
+			if (0!=(i%3)) {
+				selectTargetLbaCtx(pCtx, &lba, &dist);
+				for (j=0; pending[j]!=lba; j++) {
+					assert(j<LINK_TEST_NODES-1);
+				}
+			}
+			completeTargetCtx(pCtx, pending[j]);
+			if (0==(i%LINK_TEST_SWITCH)) {
+				setReorderStrategyCtx(pCtx, getReorderStrategy(SHORTEST_DIST));
+				selectTargetLbaCtx(pCtx, &lba, &dist);
+				setReorderStrategyCtx(pCtx, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+			}
+		} else {
+			j=i;
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (getLbaHandleCtx(pCtx, lba, &handle));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pCtx, lba, 1));
+		pending[j]=lba;
+		// Every link of the reordered list is cached and within the bounds of the band and the SG of its source.
+		pathDist=0;
+		for (pSeg=&pCtx->pSegmentPool[pCtx->pSegmentPool[pCtx->dpReorder.reordered.head].next];
+				(0!=pCtx->dpReorder.totalReordered) && (pSeg->next!=pCtx->dpReorder.reordered.tail); pSeg=pNext) {
+			pNext=&pCtx->pSegmentPool[pSeg->next];
+			getDistanceCtx(pCtx, pSeg->sg, pSeg->track, pNext->sg, pNext->track, &linkDist);
+			assert(linkDist<=pCtx->dpReorder.linkBound[pSeg->sg][pSeg->track/TRACKS_PER_BAND]);
+			assert(linkDist<=pCtx->dpReorder.sgLinkBound[pSeg->sg]);
+			assert(linkDist==pCtx->pLinkDist[pSeg-pCtx->pSegmentPool]);
+			pathDist+=linkDist;
+		}
+		getPlannedPathCtx(pCtx, &entries, &plannedDist);
+		assert(entries==pCtx->dpReorder.totalReordered);
+		assert(plannedDist==pathDist);
+	}
+	destroyReorderCtx(pCtx);
+}
+
+/**
+ *  @brief  Finds the most any move of a run of 1 to IMPROVE_MAX_RUN entries of the reordered list saves, but for the first entry,
+ *			trying every run and every link it could move into
+ *  @param  reorder_ctx_t *pCtx - context with PATH_BUILDING_FROM_LBA
+ *  @return the most distance a move saves, 0 or less if none saves any
+ */
+int getBestRunMove(reorder_ctx_t *pCtx) {
+	segment_t	**ppPath=malloc(pCtx->dpReorder.totalReordered*sizeof(segment_t *));
+	segment_t	*pSeg;
+	unsigned	m, s, e, c, toFirstDist, lastToNextDist, prevToNextDist;
+	int			removeGain, gain, best=INT32_MIN;
+
+	assert(NULL!=ppPath);
+	m=0;
+	for (pSeg=&pCtx->pSegmentPool[pCtx->pSegmentPool[pCtx->dpReorder.reordered.head].next];
+			pSeg!=&pCtx->pSegmentPool[pCtx->dpReorder.reordered.tail]; pSeg=&pCtx->pSegmentPool[pSeg->next]) {
+		ppPath[m++]=pSeg;
+	}
+	for (s=1; s<m; s++) {
+		for (e=s; (e<m) && (e<s+IMPROVE_MAX_RUN); e++) {
+			removeGain=(int)pCtx->pLinkDist[ppPath[s-1]-pCtx->pSegmentPool];
+			if (e<m-1) {
+				getDistanceCtx(pCtx, ppPath[s-1]->sg, ppPath[s-1]->track, ppPath[e+1]->sg, ppPath[e+1]->track, &prevToNextDist);
+				removeGain+=(int)pCtx->pLinkDist[ppPath[e]-pCtx->pSegmentPool]-(int)prevToNextDist;
+			}
+			for (c=0; c<m; c++) {
+				if ((c>=s-1) && (c<=e)) {
+					continue;
+				}
+				getDistanceCtx(pCtx, ppPath[c]->sg, ppPath[c]->track, ppPath[s]->sg, ppPath[s]->track, &toFirstDist);
+				gain=removeGain-(int)toFirstDist;
+				if (c<m-1) {
+					getDistanceCtx(pCtx, ppPath[e]->sg, ppPath[e]->track, ppPath[c+1]->sg, ppPath[c+1]->track, &lastToNextDist);
+					gain+=(int)pCtx->pLinkDist[ppPath[c]-pCtx->pSegmentPool]-(int)lastToNextDist;
+				}
+				best=MAX(best, gain);
+			}
+		}
+	}
+	free(ppPath);
+	return best;
+}
+
+/**
+ *  @brief  Check that improvePlanCtx() on planned path building takes out of the planned path what it says it saved,
+ *			keeps the selected entry first while it is in flight and the cached link distances exact, stops at a local optimum,
+ *			and that every entry still comes out once.
+ *  @param  None
+ *  @return None
+ */
+void checkImprover(void) {
+	reorder_ctx_t		*pCtx=createReorderCtx(IMPROVE_TEST_NODES);
+	reorder_handle_t	handle;
+	segment_t			*pSeg, *pNext;
+	unsigned			i, lba, dist, linkDist, pathDist, entries, before, after, saved, count, totalSaved=0, overruns=0;
+	uint32_t			x=2468013u;
+	struct timespec		start, end;
+
+	printf("Checking the improvement of planned path building.\n");
+	setReorderStrategyCtx(pCtx, getReorderStrategy(PATH_BUILDING_FROM_LBA));
+	setPlannerCtx(pCtx, true);
+	for (i=0; i<IMPROVE_TEST_NODES+IMPROVE_TEST_LOOP; i++) {
+		if (i>=IMPROVE_TEST_NODES) {
+			selectTargetLbaCtx(pCtx, &lba, &dist);
+			// Most improvements run out of time, every tenth one runs to a local optimum.
+			getPlannedPathCtx(pCtx, &entries, &before);
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			saved=improvePlanCtx(pCtx, (0==(i%10))?1000000000ull:IMPROVE_TEST_NS);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			if ((0!=(i%10)) && ((end.tv_sec-start.tv_sec)*1000000000LL+(end.tv_nsec-start.tv_nsec)>IMPROVE_TEST_NS+IMPROVE_TEST_SLACK_NS)) {
+				overruns++;
+			}
+			getPlannedPathCtx(pCtx, &count, &after);
+			assert((count==entries) && (before==after+saved));
+			totalSaved+=saved;
+			if (0==(i%10)) {
+				assert(0==improvePlanCtx(pCtx, 1000000000ull));
+			}
+			// At a local optimum, no move of a run saves anything.
+			if (0==(i%100)) {
+				assert(getBestRunMove(pCtx)<=0);
+			}
+			// The selected entry is still first.
+			assert(pCtx->pSegmentPool[pCtx->pSegmentPool[pCtx->dpReorder.reordered.head].next].key==lba);
+			completeTargetCtx(pCtx, lba);
+		}
+		do {
+			x^=x<<13; x^=x>>17; x^=x<<5;
+			lba=x%NUMBER_OF_BLOCKS;
+		} while (getLbaHandleCtx(pCtx, lba, &handle));
+		assert(REORDER_INVALID_HANDLE!=addLbaCtx(pCtx, lba, 1));
+		(void)planReorderCtx(pCtx, NUMBER_OF_REORDERED);
+		// Every link is cached exactly and they add up to the planned path.
+		pathDist=0;
+		count=0;
+		for (pSeg=&pCtx->pSegmentPool[pCtx->pSegmentPool[pCtx->dpReorder.reordered.head].next];
+				pSeg!=&pCtx->pSegmentPool[pCtx->dpReorder.reordered.tail]; pSeg=pNext) {
+			pNext=&pCtx->pSegmentPool[pSeg->next];
+			count++;
+			if (pNext!=&pCtx->pSegmentPool[pCtx->dpReorder.reordered.tail]) {
+				getDistanceCtx(pCtx, pSeg->sg, pSeg->track, pNext->sg, pNext->track, &linkDist);
+				assert(linkDist==pCtx->pLinkDist[pSeg-pCtx->pSegmentPool]);
+				pathDist+=linkDist;
+			}
+		}
+		getPlannedPathCtx(pCtx, &entries, &after);
+		assert((count==entries) && (pathDist==after));
+	}
+	assert(0!=totalSaved);
+	// The budget holds, bar a preemption now and then.
+	printf("Improvements over budget: %u of %u.\n", overruns, IMPROVE_TEST_LOOP-IMPROVE_TEST_LOOP/10);
+	assert(overruns<=IMPROVE_TEST_LOOP/100);
+	// Every entry comes out once.
+	for (i=0; i<IMPROVE_TEST_NODES; i++) {
+		selectTargetLbaCtx(pCtx, &lba, &dist);
+		assert(getLbaHandleCtx(pCtx, lba, &handle));
+		completeTargetCtx(pCtx, lba);
+		(void)improvePlanCtx(pCtx, IMPROVE_TEST_NS);
+	}
+	assert((0==pCtx->cacheMgmt.tavl.active_nodes) && (0==pCtx->dpReorder.totalReordered));
+	// Nothing to improve for a strategy without the hook
+	setReorderStrategyCtx(pCtx, getReorderStrategy(SHORTEST_DIST));
+	assert(0==improvePlanCtx(pCtx, 1000000000ull));
+	destroyReorderCtx(pCtx);
+}
+
 void main(void) {
     time_t t;
 	unsigned lba, numberOfBlocks;
     unsigned i;
     segment_t *tSeg, *cSeg, *nextSeg;
-    tavl_node_t *cNode,*higherNode, *nextNode;
+    segIdx_t cNode, nextNode;
+	reorder_ctx_t *pCtx;
     unsigned currentLba, currentNB;
     unsigned totalSgDist, dist, totalTrackDist;
 	unsigned rand_i;
@@ -66,10 +1763,33 @@ void main(void) {
 	prevSg=0;
 	prevTrack=0;
 
-    initCache(NUM_OF_TEST_NODES);
+    pCtx=createReorderCtx(NUM_OF_TEST_NODES);
 	getNumOfBlocks(&numberOfBlocks);
     printf("Initialized cache with NUM_OF_TEST_NODES, number of blocks:%d.\n", numberOfBlocks);
 
+    printf("Checking getDistance() for all (sgDiff, trackDiff) pairs.\n");
+	checkDistance(pCtx);
+	checkDistanceBatch(pCtx);
+	checkContexts();
+	checkSubmitRing();
+	checkBatch();
+	checkTreeOps();
+	checkFingerSearch();
+	checkHandles();
+	checkSlabPool();
+	checkAdmission();
+	checkStrategies();
+	checkGovernor();
+	checkTuner();
+	checkWithinRange();
+	checkLookahead();
+	checkWindowDp();
+	checkSelectBudget();
+	checkPlanner();
+	checkPlannerThread();
+	checkLinkIndex();
+	checkImprover();
+
     // Test TAVL tree insertion and removal operation, with coherency management.
     // - Initialize the cache
     // - Get a segment from free pool
@@ -87,22 +1807,22 @@ void main(void) {
 		do {
 			rand_i = ((rand()&0xff)<<24) + ((rand()&0xff)<<16) + ((rand()&0xff)<<8) + (rand()&0xff);
 			lba = rand_i % numberOfBlocks;
-			cNode=searchAvl(cacheMgmt.tavl.root, lba);
-			if (NULL!=cNode) {
-				printf("rand_i:%d, searchAvl(%d) returned cNode:%p with LBA range %d.\n", rand_i, lba, cNode, cNode->pSeg->key);
+			cNode=searchAvl(&pCtx->cacheMgmt.tavl, lba);
+			if (NULL_SEG_IDX!=cNode) {
+				printf("rand_i:%d, searchAvl(%d) returned cNode:%u with LBA range %d.\n", rand_i, lba, cNode, pCtx->pSegmentPool[cNode].key);
 			}
 			j++;
 			if (j>30) {
 				printf("Could not add a new LBA.\n");
 				assert(false);
 			}
-        } while (NULL!=cNode);
+        } while (NULL_SEG_IDX!=cNode);
 
         // printf("%dth LBA %d will be inserted.\n", i, lba);
 		// For the time being, use only 1 block.
-		addLba(lba, 1);
+		addLbaCtx(pCtx, lba, 1);
 		getPhyFromLba(lba, &newSg, &newTrack);
-		getDistance(prevSg, prevTrack, newSg, newTrack, &unreorderedDist);
+		getDistanceCtx(pCtx, prevSg, prevTrack, newSg, newTrack, &unreorderedDist);
 		totalUnreorderedDist+=unreorderedDist;
 		prevSg=newSg;
 		prevTrack=newTrack;
@@ -111,17 +1831,18 @@ void main(void) {
 
     // Scan the Thread and make sure all segments are ordered
     // Fetch the first segment in the Thread, one that is pointed by cacheMgmt.tavl.lowest.higher.
-    cNode=cacheMgmt.tavl.lowest.higher;
+    cNode=tavlLink(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.lowest)->higher;
     currentLba=0;
     currentNB=0;
     i=0;
-    while (cNode!=&cacheMgmt.tavl.highest) {
+    while (cNode!=pCtx->cacheMgmt.tavl.highest) {
+        cSeg=&pCtx->pSegmentPool[cNode];
         // Make sure this segment has an LBA that is equal or bigger than previous LBA + number of blocks
-        assert(cNode->pSeg->key>=currentLba+currentNB);
-        currentLba=cNode->pSeg->key;
-        // (void)dumpPathToKey(cacheMgmt.tavl.root, currentLba);
-        currentNB=cNode->pSeg->numberOfBlocks;
-        cNode=cNode->higher;
+        assert(cSeg->key>=currentLba+currentNB);
+        currentLba=cSeg->key;
+        // (void)dumpPathToKey(&cacheMgmt.tavl, cacheMgmt.tavl.root, currentLba);
+        currentNB=cSeg->numberOfBlocks;
+        cNode=tavlLink(&pCtx->cacheMgmt.tavl, cNode)->higher;
         i++;
     }
 
@@ -130,14 +1851,14 @@ void main(void) {
 	totalSgDist=0;
 	totalTrackDist=0;
 	i=0;
-	while ((i<TEST_LOOP) && (cacheMgmt.tavl.root)) {
+	while ((i<TEST_LOOP) && (NULL_SEG_IDX!=pCtx->cacheMgmt.tavl.root)) {
 		// printf("selectTargetFromCurrent()\n");
 #if defined(PERF_LOGGING_X86)
         loopStart=__builtin_ia32_rdtsc();
 #elif defined(PERF_LOGGING_ARM)
         gettimeofday(&loopStart, NULL);
 #endif // PERF_LOGGING_X86 or PERF_LOGGING_ARM
-		cNode=selectTargetFromCurrent(&dist);
+		cSeg=selectTargetFromCurrentCtx(pCtx, &dist);
 #if defined(PERF_LOGGING_X86)
         selectTime=__builtin_ia32_rdtsc();
 #elif defined(PERF_LOGGING_ARM)
@@ -145,11 +1866,11 @@ void main(void) {
 #endif // PERF_LOGGING_X86 or PERF_LOGGING_ARM
 
 		totalSgDist+=dist;
-		totalTrackDist+=abs(cNode->pSeg->track-cacheMgmt.currentTrack);
+		totalTrackDist+=abs(cSeg->track-pCtx->cacheMgmt.currentTrack);
 
-		// printf("LBA %d to %d, SG %d to %d, track %d to %d\n", cacheMgmt.currentLba, cNode->pSeg->key, cacheMgmt.currentSg, cNode->pSeg->sg, cacheMgmt.currentTrack, cNode->pSeg->track);
-		// printf("completeTarget(%d)\n",cNode->pSeg->key);
-		completeTarget(cNode->pSeg->key);
+		// printf("LBA %d to %d, SG %d to %d, track %d to %d\n", cacheMgmt.currentLba, cSeg->key, cacheMgmt.currentSg, cSeg->sg, cacheMgmt.currentTrack, cSeg->track);
+		// printf("completeTarget(%d)\n",cSeg->key);
+		completeTargetCtx(pCtx, cSeg->key);
 #if defined(PERF_LOGGING_X86)
         completeTargetTime=__builtin_ia32_rdtsc();
         printf("X86 rdtsc CPU cycles diff for select:%lu, complete:%lu.\n", selectTime-loopStart, completeTargetTime-selectTime);
@@ -166,21 +1887,21 @@ void main(void) {
 			rand_i = ((rand()&0xff)<<24) + ((rand()&0xff)<<16) + ((rand()&0xff)<<8) + (rand()&0xff);
 			lba = rand_i % numberOfBlocks;
 			// printf("searchAvl(%d)\n",lba);
-			cNode=searchAvl(cacheMgmt.tavl.root, lba);
-			if (NULL!=cNode) {
-				printf("searchAvl(%d) returned cNode:%p with LBA range %d. %uth.\n", lba, cNode, cNode->pSeg->key, i);
+			cNode=searchAvl(&pCtx->cacheMgmt.tavl, lba);
+			if (NULL_SEG_IDX!=cNode) {
+				printf("searchAvl(%d) returned cNode:%u with LBA range %d. %uth.\n", lba, cNode, pCtx->pSegmentPool[cNode].key, i);
 			}
 			j++;
 			if (j>30) {
 				printf("Could not add a new LBA after deleting.\n");
 				assert(false);
 			}
-        } while (NULL!=cNode);
+        } while (NULL_SEG_IDX!=cNode);
 		// For the time being, use only 1 block.
 		// printf("addLba(%d)\n", lba);
-		addLba(lba, 1);
+		addLbaCtx(pCtx, lba, 1);
 		getPhyFromLba(lba, &newSg, &newTrack);
-		getDistance(prevSg, prevTrack, newSg, newTrack, &unreorderedDist);
+		getDistanceCtx(pCtx, prevSg, prevTrack, newSg, newTrack, &unreorderedDist);
 		totalUnreorderedDist+=unreorderedDist;
 		prevSg=newSg;
 		prevTrack=newTrack;
@@ -191,7 +1912,7 @@ void main(void) {
 #if 1
     // Drain the left over to calculate total distance for all entries.
 	i=0;
-	while (cacheMgmt.tavl.active_nodes>=2) {
+	while (pCtx->cacheMgmt.tavl.active_nodes>=2) {
 		// If there is only one left, we cannot reorder
 		// printf("selectTargetFromCurrent()\n");
 #if defined(PERF_LOGGING_X86)
@@ -199,7 +1920,7 @@ void main(void) {
 #elif defined(PERF_LOGGING_ARM)
         gettimeofday(&loopStart, NULL);
 #endif // PERF_LOGGING_X86 or PERF_LOGGING_ARM
-		cNode=selectTargetFromCurrent(&dist);
+		cSeg=selectTargetFromCurrentCtx(pCtx, &dist);
 #if defined(PERF_LOGGING_X86)
         selectTime=__builtin_ia32_rdtsc();
 #elif defined(PERF_LOGGING_ARM)
@@ -207,10 +1928,10 @@ void main(void) {
 #endif // PERF_LOGGING_X86 or PERF_LOGGING_ARM
 
 		totalSgDist+=dist;
-		totalTrackDist+=abs(cNode->pSeg->track-cacheMgmt.currentTrack);
-        // printf("LBA %d to %d, SG %d to %d, track %d to %d\n", cacheMgmt.currentLba, cNode->pSeg->key, cacheMgmt.currentSg, cNode->pSeg->sg, cacheMgmt.currentTrack, cNode->pSeg->track);
-		// printf("completeTarget(%d)\n",cNode->pSeg->key);
-		completeTarget(cNode->pSeg->key);
+		totalTrackDist+=abs(cSeg->track-pCtx->cacheMgmt.currentTrack);
+        // printf("LBA %d to %d, SG %d to %d, track %d to %d\n", cacheMgmt.currentLba, cSeg->key, cacheMgmt.currentSg, cSeg->sg, cacheMgmt.currentTrack, cSeg->track);
+		// printf("completeTarget(%d)\n",cSeg->key);
+		completeTargetCtx(pCtx, cSeg->key);
 #if defined(PERF_LOGGING_X86)
         completeTargetTime=__builtin_ia32_rdtsc();
         printf("X86 rdtsc CPU cycles diff for select:%lu, complete:%lu.\n", selectTime-loopStart, completeTargetTime-selectTime);
@@ -228,52 +1949,49 @@ void main(void) {
     // Traverse the Thread and remove each & every node from TAVL and the list. Node gets returned to free pool.
     // Fetch the first segment in the Thread, one that is pointed by cacheMgmt.tavl.lowest.higher.
     printf("Removing all nodes in the Thread\n");
-    cNode=cacheMgmt.tavl.lowest.higher;
-    while (cNode!=&cacheMgmt.tavl.highest) {
+    cNode=tavlLink(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.lowest)->higher;
+    while (cNode!=pCtx->cacheMgmt.tavl.highest) {
         // Remove this node
-        nextNode=cNode->higher;
-        freeNode(cNode->pSeg);
+        nextNode=tavlLink(&pCtx->cacheMgmt.tavl, cNode)->higher;
+        freeNode(pCtx, &pCtx->pSegmentPool[cNode]);
         cNode=nextNode;
     }
 
     // Traverse the LRU and dump any remaining segments.
     printf("Dumping any segments in LRU, there should be none left\n");
-    tSeg=cacheMgmt.lru.head.next;
+    tSeg=&pCtx->pSegmentPool[pCtx->pSegmentPool[pCtx->cacheMgmt.lru.head].next];
     i=0;
-    while (tSeg!=&cacheMgmt.lru.tail) {
+    while (tSeg!=&pCtx->pSegmentPool[pCtx->cacheMgmt.lru.tail]) {
         printf("%dth seg %p in the LRU, LBA range [%d..%d]\n", i, tSeg, tSeg->key, tSeg->key+tSeg->numberOfBlocks);
         // Remove this node
-        tSeg=tSeg->next;
+        tSeg=&pCtx->pSegmentPool[tSeg->next];
         i++;
     }
 
     // Confirm that AVL tree, Thread and LRU are empty
     printf("Checking the tree is empty\n");
-    assert(NULL==cacheMgmt.tavl.root);
+    assert(NULL_SEG_IDX==pCtx->cacheMgmt.tavl.root);
     printf("Checking the thread is empty\n");
-    assert(cacheMgmt.tavl.lowest.higher==&cacheMgmt.tavl.highest);
-    assert(cacheMgmt.tavl.highest.lower==&cacheMgmt.tavl.lowest);
+    assert(tavlLink(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.lowest)->higher==pCtx->cacheMgmt.tavl.highest);
+    assert(tavlLink(&pCtx->cacheMgmt.tavl, pCtx->cacheMgmt.tavl.highest)->lower==pCtx->cacheMgmt.tavl.lowest);
     printf("Checking the LRU is empty\n");
-    assert(cacheMgmt.lru.head.next==&cacheMgmt.lru.tail);
-    assert(cacheMgmt.lru.tail.prev==&cacheMgmt.lru.head);
+    assert(pCtx->pSegmentPool[pCtx->cacheMgmt.lru.head].next==pCtx->cacheMgmt.lru.tail);
+    assert(pCtx->pSegmentPool[pCtx->cacheMgmt.lru.tail].prev==pCtx->cacheMgmt.lru.head);
     printf("Checking all SG trees are empty\n");
     for (i = 0; i < NUMBER_OF_SG; i++) {
-        assert(pSgTavl[i].root==NULL);
-        assert(pSgTavl[i].lowest.higher==&pSgTavl[i].highest);
-        assert(pSgTavl[i].highest.lower==&pSgTavl[i].lowest);
+#if (SELECTED_SG_CONTAINER==SG_CONTAINER_ARRAY)
+        assert(pCtx->pSgArray[i].count==0);
+#else
+        assert(pCtx->pSgTavl[i].root==NULL_SEG_IDX);
+        assert(tavlLink(&pCtx->pSgTavl[i], pCtx->pSgTavl[i].lowest)->higher==pCtx->pSgTavl[i].highest);
+        assert(tavlLink(&pCtx->pSgTavl[i], pCtx->pSgTavl[i].highest)->lower==pCtx->pSgTavl[i].lowest);
+#endif
     }
 
     printf("Test successful. Total time distance: unreordered:%d, reordered:%d. Total tracks traveled:%d.\n", totalUnreorderedDist, totalSgDist, totalTrackDist);
-#if (SELECTED_REORDERING==LBA_SAWTOOTH_REORDERING)
-    printf("Gain from LBA_SAWTOOTH_REORDERING reordering:%.3f. Entries at a time:%u, test loop:%u\n", (float)totalUnreorderedDist/(float)totalSgDist, NUM_OF_TEST_NODES, TEST_LOOP);
-#elif (SELECTED_REORDERING==SHORTEST_DIST)
-    printf("Gain from SHORTEST_DIST reordering:%.3f. Entries at a time:%u, test loop:%u\n", (float)totalUnreorderedDist/(float)totalSgDist, NUM_OF_TEST_NODES, TEST_LOOP);
-#elif (SELECTED_REORDERING==SHORTEST_DIST_AND_LBA)
-    printf("Gain from SHORTEST_DIST_AND_LBA reordering:%.3f. Entries at a time:%u, test loop:%u\n", (float)totalUnreorderedDist/(float)totalSgDist, NUM_OF_TEST_NODES, TEST_LOOP);
-#elif (SELECTED_REORDERING==SHORTEST_DIST_WITHIN_RANGE)
-    printf("Gain from SHORTEST_DIST_WITHIN_RANGE cacheMgmt.maxTrackRange that takes half of NUMBER_OF_SG(%u):%u, cacheMgmt.maxBacktrack:%u\n", NUMBER_OF_SG, cacheMgmt.maxTrackRange, cacheMgmt.maxBacktrack);
-    printf("Gain from SHORTEST_DIST_WITHIN_RANGE reordering:%.3f. Entries at a time:%u, test loop:%u\n", (float)totalUnreorderedDist/(float)totalSgDist, NUM_OF_TEST_NODES, TEST_LOOP);
-#elif (SELECTED_REORDERING==PATH_BUILDING_FROM_LBA)
-    printf("Gain from PATH_BUILDING_FROM_LBA reordering:%.3f. Entries at a time:%u, test loop:%u\n", (float)totalUnreorderedDist/(float)totalSgDist, NUM_OF_TEST_NODES, TEST_LOOP);
-#endif
+	if (getReorderStrategy(SHORTEST_DIST_WITHIN_RANGE)==pCtx->pStrategy) {
+		printf("Gain from %s cacheMgmt.maxTrackRange that takes half of NUMBER_OF_SG(%u):%u, cacheMgmt.maxBacktrack:%u\n", pCtx->pStrategy->name, NUMBER_OF_SG, pCtx->cacheMgmt.maxTrackRange, pCtx->cacheMgmt.maxBacktrack);
+	}
+    printf("Gain from %s reordering:%.3f. Entries at a time:%u, test loop:%u\n", pCtx->pStrategy->name, (float)totalUnreorderedDist/(float)totalSgDist, NUM_OF_TEST_NODES, TEST_LOOP);
+	destroyReorderCtx(pCtx);
 }